@@ -0,0 +1,510 @@
+/*
+ * bench.c - Wimey micro-benchmarks (make bench)
+ *
+ * Copyright (C) 2025 Davide Usberti <usertibox@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * Measures on synthetic schemas (10, 100 and 1000 options, commands
+ * and arguments mixed) and synthetic argv of different lengths:
+ *  - registration cost of wimey_add_* (with and without capacity hint)
+ *  - wimey_parse() on the plain and on the sealed registry, in ns/token
+ *  - allocations made per parse through the context allocator
+ *  - cache misses per token (last level and L1 data), from the
+ *    hardware counters of perf_event_open() when the kernel allows
+ *  - the wimey_val_parse_* converters against strtol()/strtod()
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "wimey.h"
+
+/* Minimum time spent on each measure */
+#define BENCH_MIN_NS 100000000ull
+
+/* --------- Helpers --------- */
+
+static uint64_t now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* Counting allocator, plugged in every context */
+static size_t allocs = 0;
+
+static void *bench_alloc(size_t size, void *user) {
+	(void)user;
+	allocs++;
+	return malloc(size);
+}
+
+static void bench_free(void *ptr, void *user) {
+	(void)user;
+	free(ptr);
+}
+
+static const struct wimey_allocator_t bench_allocator = {
+	.alloc = bench_alloc,
+	.free = bench_free,
+	.user = NULL
+};
+
+/* Hardware cache miss counters of the calling thread, -1 if
+ * perf_event_open() is missing or not allowed (perf_event_paranoid,
+ * virtual machines without a PMU) */
+enum { CNT_LLC, CNT_L1D, NCOUNTERS };
+
+static int counters[NCOUNTERS] = { -1, -1 };
+static const char *counters_err = "unsupported platform";
+
+#ifdef __linux__
+static int counter_open(uint32_t type, uint64_t config) {
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+static void counters_open(void) {
+#ifdef __linux__
+	counters[CNT_LLC] = counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	counters[CNT_L1D] = counter_open(PERF_TYPE_HW_CACHE,
+					 PERF_COUNT_HW_CACHE_L1D
+					 | PERF_COUNT_HW_CACHE_OP_READ << 8
+					 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	if (counters[CNT_LLC] < 0)
+		counters_err = strerror(errno);
+#endif
+}
+
+static uint64_t counter_read(int which) {
+	uint64_t value = 0;
+
+	if (counters[which] < 0 || read(counters[which], &value, sizeof(value)) != sizeof(value))
+		return 0;
+
+	return value;
+}
+
+/* Small deterministic PRNG, results must be comparable between runs */
+static uint32_t rng_state = 2463534242u;
+
+static uint32_t rng(void) {
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+/* --------- Synthetic schema --------- */
+
+/* One command every four options, the rest are arguments
+ * cycling through every value type */
+struct schema {
+	size_t nopts;
+	size_t ncmds;
+	size_t nargs;
+	struct wimey_command_t *cmds;
+	struct wimey_argument_t *args;
+	char *names; /* key storage */
+};
+
+/* Destinations shared by every argument of the same type */
+static long dest_long;
+static double dest_double;
+static char *dest_str;
+static int dest_bool;
+
+static const enum wimey_argument_type arg_types[] = {
+	WIMEY_LONG, WIMEY_DOUBLE, WIMEY_STR, WIMEY_BOOL
+};
+
+static void schema_make(struct schema *s, size_t nopts) {
+	s->nopts = nopts;
+	s->ncmds = nopts / 4;
+	s->nargs = nopts - s->ncmds;
+	s->cmds = calloc(s->ncmds, sizeof(*s->cmds));
+	s->args = calloc(s->nargs, sizeof(*s->args));
+	s->names = calloc(nopts * 3, 32);
+
+	char *name = s->names;
+
+	for (size_t i = 0; i < s->ncmds; i++, name += 32) {
+		snprintf(name, 32, "command%zu", i);
+		s->cmds[i].key = name;
+		s->cmds[i].has_value = i % 2;
+		s->cmds[i].desc = "synthetic command";
+	}
+
+	for (size_t i = 0; i < s->nargs; i++) {
+		enum wimey_argument_type type = arg_types[i % 4];
+
+		snprintf(name, 32, "--option-%zu", i);
+		s->args[i].long_key = name;
+		name += 32;
+		snprintf(name, 32, "-o%zu", i);
+		s->args[i].short_key = name;
+		name += 32;
+
+		s->args[i].has_value = type != WIMEY_BOOL;
+		s->args[i].is_value_required = type != WIMEY_BOOL;
+		s->args[i].value_type = type;
+		s->args[i].desc = "synthetic argument";
+
+		switch (type) {
+		case WIMEY_LONG: s->args[i].value_dest = &dest_long; break;
+		case WIMEY_DOUBLE: s->args[i].value_dest = &dest_double; break;
+		case WIMEY_STR: s->args[i].value_dest = &dest_str; break;
+		default: s->args[i].value_dest = &dest_bool; break;
+		}
+	}
+}
+
+static void schema_free(struct schema *s) {
+	free(s->cmds);
+	free(s->args);
+	free(s->names);
+}
+
+static struct wimey_ctx *schema_register(const struct schema *s, size_t hint) {
+	struct wimey_ctx *ctx = wimey_ctx_new();
+	struct wimey_config_t conf = {
+		.log_level = LOG_ERR_ONLY,
+		.str_mode = WIMEY_STR_BORROW
+	};
+
+	wimey_ctx_set_allocator(ctx, &bench_allocator);
+	wimey_ctx_init_with_capacity(ctx, hint ? s->ncmds : 0, hint ? s->nargs : 0);
+	wimey_ctx_set_config(ctx, &conf);
+
+	for (size_t i = 0; i < s->ncmds; i++)
+		wimey_ctx_add_command(ctx, s->cmds[i]);
+
+	for (size_t i = 0; i < s->nargs; i++)
+		wimey_ctx_add_argument(ctx, s->args[i]);
+
+	return ctx;
+}
+
+/* --------- Synthetic argv --------- */
+
+/* Random mix of arguments (long and short keys) with their
+ * values and commands, `len` tokens after argv[0] */
+static int argv_make(const struct schema *s, char **argv, char *store, int len) {
+	int argc = 1;
+
+	argv[0] = "bench";
+
+	while (argc < len + 1) {
+		uint32_t r = rng();
+
+		if (s->ncmds > 0 && r % 5 == 0) {
+			const struct wimey_command_t *cmd = &s->cmds[(r >> 3) % s->ncmds];
+
+			argv[argc++] = cmd->key;
+			if (cmd->has_value && argc < len + 1) {
+				snprintf(store, 16, "value%u", r % 1000);
+				argv[argc++] = store;
+				store += 16;
+			}
+			continue;
+		}
+
+		const struct wimey_argument_t *arg = &s->args[(r >> 3) % s->nargs];
+
+		/* No room left for a value, pick again */
+		if (arg->has_value && argc + 1 >= len + 1)
+			continue;
+
+		argv[argc++] = (r & 4) ? arg->long_key : arg->short_key;
+
+		switch (arg->value_type) {
+		case WIMEY_LONG:
+			snprintf(store, 16, "%u", rng() % 100000);
+			break;
+		case WIMEY_DOUBLE:
+			snprintf(store, 16, "%u.%u", rng() % 1000, rng() % 1000);
+			break;
+		case WIMEY_STR:
+			snprintf(store, 16, "str%u", rng() % 1000);
+			break;
+		default:
+			continue;
+		}
+
+		argv[argc++] = store;
+		store += 16;
+	}
+
+	return argc;
+}
+
+/* --------- Benchmarks --------- */
+
+static void bench_register(const struct schema *s) {
+	for (int hint = 0; hint <= 1; hint++) {
+		uint64_t start = now_ns(), elapsed;
+		size_t runs = 0;
+
+		allocs = 0;
+		do {
+			struct wimey_ctx *ctx = schema_register(s, hint);
+
+			wimey_ctx_free(ctx);
+			runs++;
+			elapsed = now_ns() - start;
+		} while (elapsed < BENCH_MIN_NS);
+
+		printf("  register %-6s %10.1f ns/entry %8.2f allocs/registry\n",
+		       hint ? "hint" : "grow",
+		       (double)elapsed / runs / s->nopts,
+		       (double)allocs / runs);
+	}
+}
+
+static void bench_parse(const struct schema *s, int len) {
+	char **argv = calloc(len + 2, sizeof(char *));
+	char *store = calloc(len + 1, 16);
+	int argc = argv_make(s, argv, store, len);
+
+	for (int sealed = 0; sealed <= 1; sealed++) {
+		struct wimey_ctx *ctx = schema_register(s, 1);
+		uint64_t start, elapsed;
+		size_t runs = 0;
+
+		uint64_t llc, l1d;
+
+		if (sealed)
+			wimey_ctx_finalize(ctx);
+
+		allocs = 0;
+		llc = counter_read(CNT_LLC);
+		l1d = counter_read(CNT_L1D);
+		start = now_ns();
+		do {
+			wimey_ctx_parse(ctx, argc, argv);
+			runs++;
+			elapsed = now_ns() - start;
+		} while (elapsed < BENCH_MIN_NS);
+		llc = counter_read(CNT_LLC) - llc;
+		l1d = counter_read(CNT_L1D) - l1d;
+
+		printf("  parse %4d tokens %-8s %10.1f ns/token %8.2f allocs/parse",
+		       argc - 1, sealed ? "sealed" : "list",
+		       (double)elapsed / runs / (argc - 1),
+		       (double)allocs / runs);
+		if (counters[CNT_LLC] >= 0)
+			printf(" %8.3f LLC misses/token", (double)llc / runs / (argc - 1));
+		if (counters[CNT_L1D] >= 0)
+			printf(" %8.3f L1D misses/token", (double)l1d / runs / (argc - 1));
+		printf("\n");
+
+		wimey_ctx_free(ctx);
+	}
+
+	free(argv);
+	free(store);
+}
+
+/* Converter inputs */
+#define NVALUES 4096
+
+static volatile long sink_long;
+static volatile double sink_double;
+
+static void bench_convert(void) {
+	static char values[NVALUES][24];
+	uint64_t start, elapsed;
+	size_t runs;
+
+	printf("converters\n");
+
+	for (int i = 0; i < NVALUES; i++)
+		snprintf(values[i], sizeof(values[i]), "%u", rng() % (i % 2 ? 1000u : 4000000000u));
+
+	runs = 0;
+	start = now_ns();
+	do {
+		long v;
+		for (int i = 0; i < NVALUES; i++) {
+			wimey_val_parse_long(values[i], &v);
+			sink_long = v;
+		}
+		runs += NVALUES;
+		elapsed = now_ns() - start;
+	} while (elapsed < BENCH_MIN_NS);
+	printf("  wimey_val_parse_long   %8.1f ns/value\n", (double)elapsed / runs);
+
+	runs = 0;
+	start = now_ns();
+	do {
+		for (int i = 0; i < NVALUES; i++)
+			sink_long = strtol(values[i], NULL, 10);
+		runs += NVALUES;
+		elapsed = now_ns() - start;
+	} while (elapsed < BENCH_MIN_NS);
+	printf("  strtol                 %8.1f ns/value\n", (double)elapsed / runs);
+
+	for (int i = 0; i < NVALUES; i++)
+		snprintf(values[i], sizeof(values[i]), "%u.%03u", rng() % 100000, rng() % 1000);
+
+	runs = 0;
+	start = now_ns();
+	do {
+		double v;
+		for (int i = 0; i < NVALUES; i++) {
+			wimey_val_parse_double(values[i], &v);
+			sink_double = v;
+		}
+		runs += NVALUES;
+		elapsed = now_ns() - start;
+	} while (elapsed < BENCH_MIN_NS);
+	printf("  wimey_val_parse_double %8.1f ns/value\n", (double)elapsed / runs);
+
+	runs = 0;
+	start = now_ns();
+	do {
+		for (int i = 0; i < NVALUES; i++)
+			sink_double = strtod(values[i], NULL);
+		runs += NVALUES;
+		elapsed = now_ns() - start;
+	} while (elapsed < BENCH_MIN_NS);
+	printf("  strtod                 %8.1f ns/value\n", (double)elapsed / runs);
+}
+
+/* --------- Checks --------- */
+
+/* Allocator overwriting every block it frees, so values left
+ * pointing into released memory read garbage */
+union check_header {
+	size_t size;
+	long double align_ld;
+	void *align_ptr;
+};
+
+static void *check_alloc(size_t size, void *user) {
+	union check_header *h = malloc(sizeof(*h) + size);
+
+	(void)user;
+	if (h == NULL)
+		return NULL;
+	h->size = size;
+	return h + 1;
+}
+
+static void check_free(void *ptr, void *user) {
+	union check_header *h = (union check_header *)ptr - 1;
+
+	(void)user;
+	memset(ptr, 0xa5, h->size);
+	free(h);
+}
+
+static const struct wimey_allocator_t check_allocator = {
+	.alloc = check_alloc,
+	.free = check_free,
+	.user = NULL
+};
+
+/* The last line of a stream, ended by wimey_ctx_stream_end()
+ * without its newline, keeps its borrowed and lazy values */
+static int check_stream_end(void) {
+	static const char input[] = "--name first\n--name last";
+	int failed = 0;
+
+	for (int lazy = 0; lazy <= 1; lazy++) {
+		struct wimey_ctx *ctx = wimey_ctx_new();
+		struct wimey_config_t conf = {
+			.log_level = LOG_ERR_ONLY,
+			.str_mode = WIMEY_STR_BORROW,
+			.lazy = lazy
+		};
+		char *name = NULL;
+
+		wimey_ctx_set_allocator(ctx, &check_allocator);
+		wimey_ctx_init_with_capacity(ctx, 0, 1);
+		wimey_ctx_set_config(ctx, &conf);
+		wimey_ctx_add_argument(ctx, (struct wimey_argument_t){
+			.long_key = "--name",
+			.has_value = 1,
+			.is_value_required = 1,
+			.value_dest = &name,
+			.value_type = WIMEY_STR
+		});
+
+		wimey_ctx_stream_begin(ctx);
+		wimey_ctx_stream_feed(ctx, input, sizeof(input) - 1);
+		wimey_ctx_stream_end(ctx);
+
+		const char *got = lazy ? wimey_ctx_get_str(ctx, "--name") : name;
+
+		if (got == NULL || strcmp(got, "last") != 0) {
+			printf("check stream end (%s): FAILED\n", lazy ? "lazy" : "borrow");
+			failed = 1;
+		}
+
+		wimey_ctx_free(ctx);
+	}
+
+	return failed;
+}
+
+int main(void) {
+	static const size_t sizes[] = { 10, 100, 1000 };
+	static const int lengths[] = { 8, 32, 128 };
+
+	if (check_stream_end())
+		return 1;
+
+	counters_open();
+	if (counters[CNT_LLC] < 0)
+		printf("cache counters unavailable (%s)\n", counters_err);
+
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		struct schema s;
+
+		schema_make(&s, sizes[i]);
+		printf("schema %zu options (%zu commands, %zu arguments)\n",
+		       s.nopts, s.ncmds, s.nargs);
+
+		bench_register(&s);
+		for (size_t j = 0; j < sizeof(lengths) / sizeof(lengths[0]); j++)
+			bench_parse(&s, lengths[j]);
+
+		schema_free(&s);
+	}
+
+	bench_convert();
+	return 0;
+}
@@ -155,6 +155,12 @@ int main(int argc, char **argv) {
 	}
 
 	wimey_generate_help(); /* We can library-generated help argument */
+
+	/* Optionally seal the registry once everything is added,
+	 * every token is then resolved with a single hash lookup. */
+	if (wimey_finalize() != WIMEY_OK) {
+		ERR("Failed to finalize the registry");
+	}
 	
 	/* 4. You can explore and iterate over the internal command list.
 	 *    For example, you can loop through and print all the
@@ -50,14 +50,13 @@
  *
  * =================== Project Design & Todos  ========================
  *
- * TODO: "[key]=<value>" or "[key] <value>" configuration format
- *
  * TODO: (DONE) Generate help
  * TODO: (DONE) Command recognition 
  * TODO: (DONE) Value parsers e.g. wimey_val_to_int()
  * TODO: (DONE) Argument adding functions
  * TODO: (DONE) Change variable handling with arguments to get var as pointer in adder function
  * TODO: (DONE) Argument management
+ * TODO: (DONE) "[key]=<value>" or "[key] <value>" configuration format
  */
 #define _GNU_SOURCE
 #include <stdio.h>
@@ -66,6 +65,21 @@
 #include <string.h>
 #include <stdint.h>
 #include <limits.h>
+#include <float.h>
+#include <math.h>
+#include <locale.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 #include "wimey.h"
 
@@ -81,18 +95,360 @@ typedef int bool;
  * ...see header file
  */
 
-static struct {
-	struct __wimey_command_node *cmds_head;
-	struct __wimey_argument_node *args_head;
-} wimey_dict = {
-	.cmds_head = NULL,
-	.args_head = NULL
+/* Slot of the open-addressing index built by wimey_finalize(),
+ * an empty slot has node == NULL */
+struct __wimey_index_slot {
+	uint32_t hash;
+	uint32_t level;	/* command level of the key, 0 top level */
+	void *node;
+};
+
+/* Argument seen by a lazy parse: where its value is in argv
+ * and, once converted, the value itself */
+struct __wimey_lazy_slot {
+	uint32_t gen;
+	char *raw;	/* value in argv, NULL for flags */
+	int state;	/* __WIMEY_LAZY_* */
+	union wimey_value_t value;
+};
+
+/* First bytes of a key, length prefixed: byte 0 is the length
+ * (255 for 255 and more), then the first 15 characters padded
+ * with zeros. Two keys with equal blocks are equal if they are
+ * shorter than 16, longer ones compare the rest. */
+struct __wimey_key_block {
+	unsigned char b[16];
+};
+
+/* What the parser reads of a registered argument while it
+ * looks for a key, packed so the unsealed scan walks a dense
+ * array instead of the nodes (help text, names, env keys...) */
+struct __wimey_arg_hot {
+	uint32_t level;	/* see __wimey_argument_node */
+	uint16_t type;	/* value_type */
+	uint16_t flags;	/* __WIMEY_HOT_* */
+};
+
+#define __WIMEY_HOT_FLAG 1	/* takes no value */
+#define __WIMEY_HOT_HELP 2	/* --help */
+
+/* Longest token a typo suggestion is searched for, the
+ * pattern of the distance fits a machine word */
+#define __WIMEY_SUGGEST_MAX 64
+
+/* Command or argument keys of the sealed registry grouped by
+ * length for suggestions: keys of length l are keys[starts[l]]
+ * up to keys[starts[l + 1]]. Keys too long to be close to any
+ * token are left out. */
+struct __wimey_key_buckets {
+	const char **keys;
+	uint32_t starts[__WIMEY_SUGGEST_MAX + 5];
+};
+
+/* Storage of a list argument, found by its value_dest.
+ * `block` is the allocation, the items start at the first
+ * __WIMEY_LIST_ALIGN boundary in it. A list is emptied by the
+ * first value of each source (argv, environment, a config
+ * file), `gen` tells which source filled it. */
+struct __wimey_list_slot {
+	struct wimey_list_t *dest;
+	void *block;
+	size_t cap;	/* items */
+	uint32_t gen;
+};
+
+#define __WIMEY_LIST_ALIGN 64
+
+/* Room for one item of any list type: a long, a double or a
+ * pointer, `double` is wider than `long` on ILP32 */
+#define __WIMEY_MAX(a, b) ((a) > (b) ? (a) : (b))
+#define __WIMEY_LIST_ITEM \
+	__WIMEY_MAX(__WIMEY_MAX(sizeof(long), sizeof(double)), sizeof(char *))
+
+/* Stores the value of an argument in its value_dest (NULL for
+ * flags), returns false if it can't. Registered arguments get the
+ * setter of their type once, see __wimey_setter_of() */
+typedef bool (*__wimey_setter_fn)(struct wimey_ctx *ctx,
+				  const struct wimey_argument_t *arg, char *val);
+
+static __wimey_setter_fn __wimey_setter_of(const struct wimey_argument_t *arg);
+
+static bool __wimey_is_list(enum wimey_argument_type type) {
+	return type == WIMEY_LONG_LIST || type == WIMEY_DOUBLE_LIST
+	    || type == WIMEY_STR_LIST;
+}
+
+enum {
+	__WIMEY_LAZY_RAW,	/* not converted yet */
+	__WIMEY_LAZY_DONE,
+	__WIMEY_LAZY_FAILED
+};
+
+/* File mapped by __wimey_file_map() */
+struct __wimey_mapping {
+	char *addr;
+	size_t len;
+};
+
+/* Token storage of a streamed line, chunks never move */
+struct __wimey_stream_chunk {
+	struct __wimey_stream_chunk *next;
+	size_t cap, used;
+	char data[];
 };
 
-struct wimey_config_t wimey_conf = {
-	.log_level = LOG_ALL
+/* Default allocator, see wimey_ctx_set_allocator() */
+static void *__wimey_default_alloc(size_t size, void *user) {
+	(void)user;
+	return malloc(size);
+}
+
+static void __wimey_default_free(void *ptr, void *user) {
+	(void)user;
+	free(ptr);
+}
+
+/* ------- Instrumentation ------- */
+
+/* With -DWIMEY_STATS every context counts what the parser
+ * does (see wimey_get_stats()), without it the macros below
+ * compile to nothing */
+#ifdef WIMEY_STATS
+#define __WIMEY_STAT(ctx, field, n) ((ctx)->stats.field += (n))
+#define __WIMEY_CYCLES(var) uint64_t var = __wimey_cycles()
+#define __WIMEY_STAT_CYCLES(ctx, field, start) \
+	((ctx)->stats.field += __wimey_cycles() - (start))
+
+#if defined(__x86_64__) || defined(__i386__)
+static uint64_t __wimey_cycles(void) {
+	return __builtin_ia32_rdtsc();
+}
+#else
+#include <time.h>
+
+/* No cycle counter, nanoseconds instead */
+static uint64_t __wimey_cycles(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+#endif
+#else
+#define __WIMEY_STAT(ctx, field, n) ((void)0)
+#define __WIMEY_CYCLES(var) ((void)0)
+#define __WIMEY_STAT_CYCLES(ctx, field, start) ((void)0)
+#endif
+
+#define __WIMEY_ALLOC(ctx, size) \
+	(__WIMEY_STAT(ctx, allocations, 1), \
+	 (ctx)->allocator.alloc((size), (ctx)->allocator.user))
+#define __WIMEY_FREE(ctx, ptr) \
+	(ctx)->allocator.free((ptr), (ctx)->allocator.user)
+
+/* Parser context, all the library state lives here so
+ * independent contexts can be used from different threads.
+ * The wimey_* functions without `ctx` use wimey_default_ctx. */
+struct wimey_ctx {
+	struct wimey_config_t conf;
+	struct wimey_allocator_t allocator;
+
+	/* The registry is stored as two contiguous arrays, nodes
+	 * are still chained by `next` so the lists returned by
+	 * wimey_get_commands_head() and wimey_get_arguments_head()
+	 * keep working. Arrays grow geometrically, so appending is
+	 * O(1) amortized, and the chain is rebuilt when they move. */
+	struct {
+		struct __wimey_command_node *cmds;
+		struct __wimey_argument_node *args;
+		size_t ncmds, cmds_cap;
+		size_t nargs, args_cap;
+
+		/* Sealed registry, see wimey_finalize() */
+		bool sealed;
+		struct __wimey_index_slot *cmd_slots;
+		struct __wimey_index_slot *arg_slots;
+		size_t cmd_mask;
+		size_t arg_mask;
+
+		/* Position + 1 of the argument of each "-c" short key,
+		 * for bundles like -abc */
+		uint32_t shorts[256];
+
+		/* Every key sorted, built on the first completion */
+		const char **sorted_keys;
+		size_t nsorted;
+
+		/* Arguments with an env_key, indexed by variable name */
+		struct __wimey_index_slot *env_slots;
+		size_t env_mask;
+		size_t nenv;
+
+		/* Arguments with a list type */
+		size_t nlists;
+
+		/* Packed prefixes of the argument keys, long then short
+		 * for each argument, scanned by the unsealed lookup */
+		struct __wimey_key_block *arg_keys;
+		size_t keys_cap;
+
+		/* Setter and hot fields of each argument, set when it's
+		 * added. The nodes keep everything, they are only read
+		 * once a key has matched (and by the help) */
+		__wimey_setter_fn *setters;
+		struct __wimey_arg_hot *hot;
+
+		/* Keys by length for typo suggestions, commands then
+		 * arguments, built on the first unknown token */
+		struct __wimey_key_buckets suggest[2];
+
+		/* Schema file loaded by wimey_load_schema(), the nodes
+		 * and the index above point into it */
+		struct __wimey_mapping snapshot;
+	} dict;
+
+	/* Bytes of conf.str_buf used by the current parse */
+	size_t str_used;
+
+	/* List arguments: one buffer each, sized by a prescan of
+	 * argv and kept between parses */
+	struct {
+		struct __wimey_list_slot *slots;
+		size_t nslots, cap;
+		uint32_t gen;
+	} lists;
+
+	/* Lazy mode (conf.lazy): one slot per registered argument,
+	 * a slot belongs to the last parse only if its generation
+	 * matches, so nothing is cleared between parses. `preset`
+	 * holds the values of the config files (generation 1 if set),
+	 * every parse starts from them. */
+	struct {
+		struct __wimey_lazy_slot *slots;
+		size_t cap;
+		uint32_t gen;
+		struct __wimey_lazy_slot *preset;
+		size_t preset_cap;
+	} lazy;
+
+	/* Constraints of the registry arguments compiled into bitsets
+	 * over their positions: the required ones, the ones with
+	 * rules, and for each of those a row of `words` requires then
+	 * `words` conflicts (`row_of` is row + 1). `seen` holds the
+	 * arguments given to the current parse, `preset` the ones set
+	 * by config files. Built for `nargs` arguments, rebuilt when
+	 * more were added since. */
+	struct {
+		uint64_t *required;
+		uint64_t *ruled;
+		uint64_t *seen;
+		uint64_t *rows;
+		uint32_t *row_of;
+		size_t words, nargs;
+		uint64_t *preset;
+		size_t preset_words;
+	} rules;
+
+	/* Response files (conf.response_files): the mappings and the
+	 * expanded argv of the last parse, tokens point into them */
+	struct {
+		struct __wimey_mapping *maps;
+		size_t nmaps, maps_cap;
+		char **argv;
+		size_t nargv, argv_cap;
+	} argfiles;
+
+	/* Files read by wimey_load_config_file(), strings that are
+	 * not duplicated and lazy values point into them */
+	struct {
+		struct __wimey_mapping *maps;
+		size_t nmaps, maps_cap;
+		bool last_unused;	/* nothing points into the newest */
+	} configs;
+
+	/* Help text rendered for the sealed registry, kept until the
+	 * configuration or the registry changes */
+	struct {
+		char *text;
+		size_t len;
+		const char *argv0;
+	} help;
+
+	/* Arguments of the last wimey_reparse_delta(): the value of
+	 * each as a position in `pool` (or a __WIMEY_DELTA_* mark)
+	 * and the bitmap of the ones that changed */
+	struct {
+		size_t *offs;
+		uint64_t *bits;
+		size_t cap;
+		char *pool;
+		size_t pool_len;
+	} delta;
+
+	/* Push parser of wimey_stream_feed(). The tokens of a line
+	 * are unquoted into `chunks` (newest first), a value found in
+	 * a line stays valid until the next one starts. A command or
+	 * an argument waiting for its value is kept across feeds. */
+	struct {
+		bool active;
+		struct __wimey_stream_chunk *chunks;
+		size_t tok;	/* start of the partial token in chunks */
+		bool in_tok, escape;
+		char quote;
+		bool in_line;
+		bool rest;	/* after `--`, the line is ignored */
+		bool bad;	/* the line failed, skipped up to its end */
+		int ntok;	/* tokens of the line */
+		uint32_t level;
+		const struct __wimey_command_node *cmd;
+		const struct wimey_argument_t *arg;
+		size_t failures;
+		uint64_t *base;	/* constraint marks of the environment */
+		struct __wimey_lazy_slot *lazy_base; /* lazy values every line starts with */
+		char *argv0[1];
+	} stream;
+
+	/* Log sink, NULL prints to stdout/stderr */
+	struct {
+		wimey_log_fn fn;
+		void *user;
+	} log;
+
+	/* Why the last parse or load failed */
+	struct wimey_error_t error;
+
+#ifdef WIMEY_STATS
+	struct wimey_stats_t stats;
+#endif
 };
 
+#define __WIMEY_CTX_INITIALIZER { \
+	.conf = { \
+		.log_level = LOG_ERR_AND_WARNS, \
+		.str_mode = WIMEY_STR_DUP \
+	}, \
+	.allocator = { \
+		.alloc = __wimey_default_alloc, \
+		.free = __wimey_default_free, \
+		.user = NULL \
+	}, \
+	.dict = { \
+		.cmds = NULL, \
+		.args = NULL, \
+		.ncmds = 0, .cmds_cap = 0, \
+		.nargs = 0, .args_cap = 0, \
+		.sealed = false, \
+		.cmd_slots = NULL, \
+		.arg_slots = NULL, \
+		.cmd_mask = 0, \
+		.arg_mask = 0 \
+	}, \
+	.str_used = 0, \
+	.error = { .code = WIMEY_E_NONE, .index = -1 } \
+}
+
+static struct wimey_ctx wimey_default_ctx = __WIMEY_CTX_INITIALIZER;
+
 struct wimey_argument_t help_arg = {
 		.long_key = "--help",
 		.short_key = "-h",
@@ -108,247 +464,661 @@ struct wimey_argument_t help_arg = {
 #undef WARN
 #undef INFO
 
+/* Send a message of `level` (LOG_ERR_ONLY for errors,
+ * LOG_ERR_AND_WARNS for warnings, LOG_ALL for infos) to the log
+ * sink of `ctx`, or print it like the macros of wimey.h */
+static void __wimey_log(struct wimey_ctx *ctx, int level, const char *fmt, ...)
+	__attribute__((format(printf, 3, 4)));
+
+static void __wimey_log(struct wimey_ctx *ctx, int level, const char *fmt, ...) {
+	va_list ap;
+
+	va_start(ap, fmt);
+	if (ctx->log.fn != NULL) {
+		char msg[256];
+
+		vsnprintf(msg, sizeof(msg), fmt, ap);
+		ctx->log.fn(level, msg, ctx->log.user);
+	} else {
+		FILE *out = level == LOG_ERR_ONLY ? stderr : stdout;
+
+		fputs(level == LOG_ERR_ONLY ? RED "ERROR " RESET
+		      : level == LOG_ERR_AND_WARNS ? YELLOW "WARN  " RESET
+		      : GREEN "INFO  " RESET, out);
+		vfprintf(out, fmt, ap);
+		fputc('\n', out);
+	}
+	va_end(ap);
+}
+
 /* These debug macros are different from the
  * macros declared in wimey.h because here we need
  * to follow the debug level set with the lib 
- * configuration struct  */
+ * configuration struct, and its log sink. Errors are
+ * always reported, the level check is done before any
+ * formatting so disabled messages cost one branch. */
 
-#define ERR(msg, ...) \
-    do { \
-	fprintf(stderr, RED "ERROR " RESET msg "\n", ##__VA_ARGS__); \
-    } while (0)
+#define ERR(ctx, msg, ...) \
+    __wimey_log((ctx), LOG_ERR_ONLY, msg, ##__VA_ARGS__)
 
-#define WARN(msg, ...) \
+#define WARN(ctx, msg, ...) \
     do { \
-	if (wimey_conf.log_level >= LOG_ERR_AND_WARNS) \
-	    printf(YELLOW "WARN  " RESET msg "\n", ##__VA_ARGS__); \
+	if ((ctx)->conf.log_level >= LOG_ERR_AND_WARNS) \
+	    __wimey_log((ctx), LOG_ERR_AND_WARNS, msg, ##__VA_ARGS__); \
     } while (0)
 
-#define INFO(msg, ...) \
+#define INFO(ctx, msg, ...) \
     do { \
-	if (wimey_conf.log_level >= LOG_ALL) \
-	    printf(GREEN "INFO  " RESET msg "\n", ##__VA_ARGS__); \
+	if ((ctx)->conf.log_level >= LOG_ALL) \
+	    __wimey_log((ctx), LOG_ALL, msg, ##__VA_ARGS__); \
     } while (0)
 
+/* Record the failure of the current parse, only the first
+ * one: later errors are consequences of it */
+static void __wimey_fail(struct wimey_ctx *ctx, enum wimey_error_code code,
+			 const char *key, const char *value) {
+	if (ctx->error.code != WIMEY_E_NONE)
+		return;
+
+	ctx->error.code = code;
+	ctx->error.key = key;
+	ctx->error.value = value;
+}
+
+/* Start of a parse or a load, the error record is cleared */
+static void __wimey_error_reset(struct wimey_ctx *ctx) {
+	ctx->error.code = WIMEY_E_NONE;
+	ctx->error.index = -1;
+	ctx->error.key = NULL;
+	ctx->error.value = NULL;
+}
+
 
 /* prototypes */
-void __wimey_print_help(int argc, char **argv);
+struct __wimey_schema;
+void __wimey_print_help(const struct __wimey_schema *schema, int argc, char **argv);
 
-/* ------- Configuration functions ------- */
+/* ------- Registry index ------- */
 
-/* Set global library configuration 
- * --------------------------------
- * Arguments:
- *  struct wimey_config_t *conf - Pointer to configuration structure */
-int wimey_set_config(struct wimey_config_t *conf) {
-	if (conf == NULL)
-		return WIMEY_ERR;
+#define __WIMEY_HASH_SEED 2166136261u
 
-	wimey_conf = *conf;
-	return WIMEY_OK;
+/* FNV-1a continued over `str`, a key hashed in
+ * pieces gets the hash of the whole key */
+static uint32_t __wimey_hash_from(uint32_t hash, const char *str) {
+	while (*str != '\0') {
+		hash ^= (unsigned char)*str++;
+		hash *= 16777619u;
+	}
+
+	return hash;
 }
 
-/* Get global library configuration
- * -------------------------------
- * Returns: struct wimey_config_t - Current configuration */
-struct wimey_config_t wimey_get_config(void) {
-	return wimey_conf;
+/* FNV-1a hash used by the sealed registry index */
+static uint32_t __wimey_hash(const char *str) {
+	return __wimey_hash_from(__WIMEY_HASH_SEED, str);
 }
 
-/* Internal helper to create a command node */
-struct __wimey_command_node
-*wimey_create_command_node(struct wimey_command_t new_cmd) {
-	struct __wimey_command_node *new_node =
-	    (struct __wimey_command_node
-	     *)(malloc(sizeof(struct __wimey_command_node)));
+/* FNV-1a hash of `str` up to the first `stop` character */
+static uint32_t __wimey_hash_until(const char *str, char stop) {
+	uint32_t hash = __WIMEY_HASH_SEED;
 
-	if (!new_node) {
-		ERR("Failed to allocate command.");
-		return NULL;
+	while (*str != '\0' && *str != stop) {
+		hash ^= (unsigned char)*str++;
+		hash *= 16777619u;
 	}
 
-	/* Initialize heap structure */
-	memset(new_node, 0, sizeof(*new_node));
+	return hash;
+}
+
+/* Returns the number of slots needed to index `count` keys,
+ * always a power of two with a load factor <= 0.5 */
+static size_t __wimey_index_size(size_t count) {
+	size_t size = 8;
+
+	while (size < count * 2)
+		size <<= 1;
 
-	new_node->cmd = new_cmd;
-	new_node->next = NULL;
-	return new_node;
+	return size;
 }
 
-/* Adds a new command to the commands linked list */
-int wimey_add_command(struct wimey_command_t cmd) {
-	struct __wimey_command_node *new_cmd = wimey_create_command_node(cmd);
+/* Every command level shares one table: the key hash is mixed
+ * with the level so siblings of different parents spread apart,
+ * top level keys keep their plain hash */
+static uint32_t __wimey_level_hash(uint32_t hash, uint32_t level) {
+	return level != 0 ? hash ^ (level * 0x9E3779B1u) : hash;
+}
 
-	if (!new_cmd) {
-		ERR("Failed to append new command, invalid argument.");
-		return WIMEY_ERR;
+/* Insert a key of `level` in an index table. If the key is
+ * already present the first registered node wins, this
+ * matches the behavior of the linear lookup. */
+static void __wimey_index_insert(struct __wimey_index_slot *slots,
+				 size_t mask, uint32_t level, const char *key, void *node,
+				 const char *(*key_of)(void *node, const char *key)) {
+	if (key == NULL)
+		return;
+
+	uint32_t hash = __wimey_level_hash(__wimey_hash(key), level);
+	size_t i = hash & mask;
+
+	while (slots[i].node != NULL) {
+		if (slots[i].hash == hash && slots[i].level == level
+		    && key_of(slots[i].node, key) != NULL)
+			return;
+		i = (i + 1) & mask;
 	}
 
-	if (wimey_dict.cmds_head == NULL) {
-		wimey_dict.cmds_head = new_cmd;
-		return WIMEY_OK;
+	slots[i].hash = hash;
+	slots[i].level = level;
+	slots[i].node = node;
+}
+
+/* Key matchers used by the index, return the matching key
+ * of the node or NULL if `key` does not belong to it */
+static const char *__wimey_command_key_of(void *node, const char *key) {
+	struct __wimey_command_node *cmd = node;
+
+	if (strcmp(cmd->cmd.key, key) == 0)
+		return cmd->cmd.key;
+
+	return NULL;
+}
+
+/* True if `key` is `tok` up to its end or to a '=' */
+static bool __wimey_key_eq_until_eq(const char *key, const char *tok) {
+	size_t i = 0;
+
+	if (key == NULL)
+		return false;
+
+	while (key[i] != '\0' && key[i] == tok[i])
+		i++;
+
+	return key[i] == '\0' && (tok[i] == '\0' || tok[i] == '=');
+}
+
+/* True for a one character short key like "-c" */
+static bool __wimey_is_short_char(const char *key) {
+	return key != NULL && key[0] == '-' && key[1] != '\0'
+	    && key[1] != '-' && key[2] == '\0';
+}
+
+/* `key` is a variable name or a "NAME=value" environ entry */
+static const char *__wimey_env_key_of(void *node, const char *key) {
+	const char *env_key = ((struct __wimey_argument_node *)node)->argument.env_key;
+
+	return __wimey_key_eq_until_eq(env_key, key) ? env_key : NULL;
+}
+
+/* `key` is a "--key=value" token */
+static const char *__wimey_long_key_eq_of(void *node, const char *key) {
+	const char *long_key = ((struct __wimey_argument_node *)node)->argument.long_key;
+
+	return __wimey_key_eq_until_eq(long_key, key) ? long_key : NULL;
+}
+
+static const char *__wimey_argument_key_of(void *node, const char *key) {
+	struct __wimey_argument_node *arg = node;
+
+	if (arg->argument.long_key != NULL
+	    && strcmp(arg->argument.long_key, key) == 0)
+		return arg->argument.long_key;
+
+	if (arg->argument.short_key != NULL
+	    && strcmp(arg->argument.short_key, key) == 0)
+		return arg->argument.short_key;
+
+	return NULL;
+}
+
+/* Probe an index table for a key of `level` with known hash,
+ * `key_of` tells if a node matches. Returns the node or NULL */
+static void *__wimey_index_probe(struct wimey_ctx *ctx,
+				 struct __wimey_index_slot *slots,
+				 size_t mask, uint32_t level, uint32_t hash, const char *key,
+				 const char *(*key_of)(void *node, const char *key)) {
+	size_t i;
+
+	hash = __wimey_level_hash(hash, level);
+	i = hash & mask;
+
+	(void)ctx;
+	while (slots[i].node != NULL) {
+		if (slots[i].hash == hash && slots[i].level == level) {
+			__WIMEY_STAT(ctx, key_compares, 1);
+			if (key_of(slots[i].node, key) != NULL)
+				return slots[i].node;
+		}
+		i = (i + 1) & mask;
 	}
 
-	struct __wimey_command_node *current = wimey_dict.cmds_head;
+	return NULL;
+}
 
-	while (current->next != NULL) {
-		current = current->next;
+/* Probe an index table, returns the node or NULL */
+static void *__wimey_index_find(struct wimey_ctx *ctx,
+				struct __wimey_index_slot *slots,
+				size_t mask, uint32_t level, const char *key,
+				const char *(*key_of)(void *node, const char *key)) {
+	return __wimey_index_probe(ctx, slots, mask, level, __wimey_hash(key), key, key_of);
+}
+
+/* Release the index and unseal the registry */
+static void __wimey_index_free(struct wimey_ctx *ctx) {
+	if (ctx->dict.cmd_slots != NULL)
+		__WIMEY_FREE(ctx, ctx->dict.cmd_slots);
+	if (ctx->dict.arg_slots != NULL)
+		__WIMEY_FREE(ctx, ctx->dict.arg_slots);
+
+	if (ctx->dict.env_slots != NULL)
+		__WIMEY_FREE(ctx, ctx->dict.env_slots);
+	if (ctx->dict.sorted_keys != NULL)
+		__WIMEY_FREE(ctx, ctx->dict.sorted_keys);
+
+	for (int kind = 0; kind < 2; kind++) {
+		if (ctx->dict.suggest[kind].keys != NULL)
+			__WIMEY_FREE(ctx, ctx->dict.suggest[kind].keys);
+		ctx->dict.suggest[kind].keys = NULL;
 	}
 
-	current->next = new_cmd;
+	ctx->dict.sorted_keys = NULL;
+	ctx->dict.nsorted = 0;
+
+	ctx->dict.cmd_slots = NULL;
+	ctx->dict.arg_slots = NULL;
+	ctx->dict.env_slots = NULL;
+	ctx->dict.cmd_mask = 0;
+	ctx->dict.arg_mask = 0;
+	ctx->dict.env_mask = 0;
+	ctx->dict.nenv = 0;
+	memset(ctx->dict.shorts, 0, sizeof(ctx->dict.shorts));
+	ctx->dict.sealed = false;
+}
+
+/* Drop the cached help text */
+static void __wimey_help_free(struct wimey_ctx *ctx) {
+	if (ctx->help.text != NULL)
+		__WIMEY_FREE(ctx, ctx->help.text);
+
+	ctx->help.text = NULL;
+	ctx->help.len = 0;
+	ctx->help.argv0 = NULL;
+}
+
+/* ------- Configuration functions ------- */
+
+/* Set context configuration
+ * -------------------------
+ * Arguments:
+ *  struct wimey_ctx *ctx - Parser context
+ *  struct wimey_config_t *conf - Pointer to configuration structure */
+int wimey_ctx_set_config(struct wimey_ctx *ctx, struct wimey_config_t *conf) {
+	if (ctx == NULL || conf == NULL)
+		return WIMEY_ERR;
+
+	ctx->conf = *conf;
+	__wimey_help_free(ctx);
 	return WIMEY_OK;
 }
 
-/* Check if a string matches a registered command */
-bool __wimey_is_str_a_command(char *str) {
-	struct __wimey_command_node *current = wimey_get_commands_head();
+/* Get context configuration
+ * -------------------------
+ * Returns: struct wimey_config_t - Current configuration */
+struct wimey_config_t wimey_ctx_get_config(struct wimey_ctx *ctx) {
+	return ctx->conf;
+}
 
-	if (current == NULL)
-		return false;
+/* Set the log sink
+ * -----------------
+ * Every message goes to `fn` with `user` instead of being
+ * printed, NULL restores stdout/stderr */
+void wimey_ctx_set_log_sink(struct wimey_ctx *ctx, wimey_log_fn fn, void *user) {
+	ctx->log.fn = fn;
+	ctx->log.user = user;
+}
 
-	while (current != NULL) {
-		if (strncmp(current->cmd.key, str, strlen(current->cmd.key)) ==
-		    0)
-			return true;
-		current = current->next;
+/* Get the last error
+ * ------------------
+ * Returns: the failure of the last parse or configuration load,
+ * code WIMEY_E_NONE if it succeeded */
+const struct wimey_error_t *wimey_ctx_get_error(struct wimey_ctx *ctx) {
+	return &ctx->error;
+}
+
+/* Short description of an error code */
+const char *wimey_strerror(enum wimey_error_code code) {
+	switch (code) {
+	case WIMEY_E_NONE: return "no error";
+	case WIMEY_E_NO_COMMAND: return "no command given";
+	case WIMEY_E_UNKNOWN_KEY: return "unknown key";
+	case WIMEY_E_MISSING_VALUE: return "missing value";
+	case WIMEY_E_UNEXPECTED_VALUE: return "unexpected value";
+	case WIMEY_E_INVALID_VALUE: return "invalid value";
+	case WIMEY_E_FILE: return "invalid file";
+	case WIMEY_E_NO_MEMORY: return "out of memory";
+	case WIMEY_E_FORMAT: return "invalid serialized results";
+	case WIMEY_E_REQUIRED: return "required argument missing";
+	case WIMEY_E_REQUIRES: return "argument missing a dependency";
+	case WIMEY_E_CONFLICT: return "conflicting arguments";
 	}
 
-	return false;
+	return "unknown error";
 }
 
-/* Returns the head of the commands list
- * or NULL if the list is empty */
-struct __wimey_command_node *wimey_get_commands_head(void) {
-	return wimey_dict.cmds_head;
+/* Get context counters
+ * --------------------
+ * Returns: struct wimey_stats_t - zero unless built with WIMEY_STATS */
+struct wimey_stats_t wimey_ctx_get_stats(struct wimey_ctx *ctx) {
+#ifdef WIMEY_STATS
+	return ctx->stats;
+#else
+	struct wimey_stats_t none = { 0 };
+
+	(void)ctx;
+	return none;
+#endif
 }
 
-/* Given a string returns the command node */
-static struct __wimey_command_node
-*__wimey_get_command_node(char *str) {
-	struct __wimey_command_node *current = wimey_get_commands_head();
+/* Clear context counters */
+void wimey_ctx_reset_stats(struct wimey_ctx *ctx) {
+#ifdef WIMEY_STATS
+	memset(&ctx->stats, 0, sizeof(ctx->stats));
+#else
+	(void)ctx;
+#endif
+}
 
-	if (current == NULL)
-		return NULL;
+/* ------- Registry storage ------- */
 
-	while (current != NULL) {
-		bool is_valid_key = strcmp(str, current->cmd.key);
+/* Resize a registry array to hold `cap` elements,
+ * returns false on allocation failure */
+static bool __wimey_resize(struct wimey_ctx *ctx, void **array, size_t count, size_t cap, size_t elem) {
+	void *new_array = __WIMEY_ALLOC(ctx, cap * elem);
 
-		if (is_valid_key == 0)
-			return current;
+	if (new_array == NULL)
+		return false;
 
-		current = current->next;
+	if (*array != NULL) {
+		memcpy(new_array, *array, count * elem);
+		__WIMEY_FREE(ctx, *array);
 	}
 
-	return NULL;
+	*array = new_array;
+	return true;
 }
 
-/* Given a string returns if it's a valid command  */
-bool __wimey_check_command(char *str) {
-	return __wimey_get_command_node(str) != NULL;
+/* Returns the next free command slot, NULL on failure */
+static struct __wimey_command_node *__wimey_command_slot(struct wimey_ctx *ctx) {
+	if (ctx->dict.ncmds == ctx->dict.cmds_cap) {
+		size_t cap = ctx->dict.cmds_cap ? ctx->dict.cmds_cap * 2 : 8;
+
+		if (!__wimey_resize(ctx, (void **)&ctx->dict.cmds, ctx->dict.ncmds,
+				    cap, sizeof(struct __wimey_command_node)))
+			return NULL;
+
+		ctx->dict.cmds_cap = cap;
+
+		/* Array moved, chain it again */
+		for (size_t i = 0; i + 1 < ctx->dict.ncmds; i++)
+			ctx->dict.cmds[i].next = &ctx->dict.cmds[i + 1];
+	}
+
+	return &ctx->dict.cmds[ctx->dict.ncmds];
 }
 
-/* Process a specific command with its value if needed */
-bool __wimey_process_command(struct __wimey_command_node *cmd_node, char *value) {
-	if (cmd_node->cmd.has_value) {
-		cmd_node->cmd.callback(value);
-		return true;
+/* Returns the next free argument slot, NULL on failure */
+static struct __wimey_argument_node *__wimey_argument_slot(struct wimey_ctx *ctx) {
+	if (ctx->dict.nargs == ctx->dict.args_cap) {
+		size_t cap = ctx->dict.args_cap ? ctx->dict.args_cap * 2 : 8;
+
+		if (!__wimey_resize(ctx, (void **)&ctx->dict.args, ctx->dict.nargs,
+				    cap, sizeof(struct __wimey_argument_node)))
+			return NULL;
+
+		ctx->dict.args_cap = cap;
+
+		for (size_t i = 0; i + 1 < ctx->dict.nargs; i++)
+			ctx->dict.args[i].next = &ctx->dict.args[i + 1];
 	}
 
-	cmd_node->cmd.callback(NULL);
-	return true;
+	return &ctx->dict.args[ctx->dict.nargs];
 }
 
-/* Internal function that iterates through
- * command line arguments searching for commands.
- * Executes callbacks and returns status */
-int __wimey_parse_commands(int argc, char **argv) {
-	if (wimey_get_commands_head() == NULL)
-		return WIMEY_OK;
+/* Pack the block of `key`, a missing key gets a length no
+ * token can have in 15 bytes of zeros */
+static void __wimey_key_pack(struct __wimey_key_block *block, const char *key) {
+	size_t len = key != NULL ? strlen(key) : 0;
 
-	if (argc < 2) {
-		ERR("Argc < 2, but commands exist in the dictionary");
-		goto err;
+	memset(block, 0, sizeof(*block));
+	if (key == NULL) {
+		block->b[0] = 0xff;
+		return;
 	}
 
-	for (int arg_i = 0; arg_i < argc; arg_i++) {
-		char *current_cmd = argv[arg_i];
-		bool is_cmd_in_dict = __wimey_check_command(current_cmd);
-		bool overflow = arg_i + 1 >= argc;
+	block->b[0] = len < 255 ? len : 255;
+	memcpy(block->b + 1, key, len < 15 ? len : 15);
+}
 
-		if (!is_cmd_in_dict)
-			continue;
+/* Compare two blocks, 16 bytes at once where SIMD is available */
+static bool __wimey_key_block_eq(const struct __wimey_key_block *a,
+				 const struct __wimey_key_block *b) {
+#if defined(__SSE2__)
+	__m128i x = _mm_loadu_si128((const __m128i *)a->b);
+	__m128i y = _mm_loadu_si128((const __m128i *)b->b);
+
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) == 0xffff;
+#elif defined(__ARM_NEON)
+	uint64x2_t eq = vreinterpretq_u64_u8(vceqq_u8(vld1q_u8(a->b), vld1q_u8(b->b)));
+
+	return (vgetq_lane_u64(eq, 0) & vgetq_lane_u64(eq, 1)) == UINT64_MAX;
+#else
+	return memcmp(a->b, b->b, sizeof(a->b)) == 0;
+#endif
+}
 
-		struct __wimey_command_node *node =
-		    __wimey_get_command_node(current_cmd);
+/* Does the key of `block` match `tok` of `tok_block`. `key`
+ * is where the key pointer is, it's only read for keys longer
+ * than a block, so a miss doesn't touch the node */
+static bool __wimey_key_match(const struct __wimey_key_block *block, char *const *key,
+			      const struct __wimey_key_block *tok_block, const char *tok) {
+	if (!__wimey_key_block_eq(block, tok_block))
+		return false;
 
-		if (!node) {
-			ERR("Failed to get node pointer");
-			goto err;
-		}
+	return block->b[0] < 16 || strcmp(*key + 15, tok + 15) == 0;
+}
 
-		if (node->cmd.is_value_required && overflow) {
-			ERR("Command %s requires value `%s` but none provided",
-			    node->cmd.key, node->cmd.value_name);
-			goto err;
-		}
+/* Hot fields of a registered argument */
+static void __wimey_hot_set(struct __wimey_arg_hot *hot, const struct __wimey_argument_node *node) {
+	const struct wimey_argument_t *arg = &node->argument;
+
+	hot->level = node->level;
+	hot->type = arg->value_type;
+	hot->flags = 0;
+	if (arg->value_type == WIMEY_BOOL || !arg->has_value || !arg->is_value_required)
+		hot->flags |= __WIMEY_HOT_FLAG;
+	if (arg->long_key != NULL && strcmp(arg->long_key, help_arg.long_key) == 0)
+		hot->flags |= __WIMEY_HOT_HELP;
+}
 
-		if (node->cmd.has_value && !overflow) {
-			INFO("Found command: %s", node->cmd.key);
+/* Keep room for the key blocks, the setter and the hot
+ * fields of the next argument */
+static bool __wimey_argument_data_reserve(struct wimey_ctx *ctx) {
+	if (ctx->dict.nargs < ctx->dict.keys_cap)
+		return true;
 
-			if (node->cmd.is_value_required && overflow) {
-				ERR("Command %s requires value `%s` but none provided", node->cmd.key, node->cmd.value_name);
-				goto err;
-			}
+	size_t cap = ctx->dict.args_cap > ctx->dict.nargs ? ctx->dict.args_cap
+							  : ctx->dict.nargs + 1;
+
+	if (!__wimey_resize(ctx, (void **)&ctx->dict.arg_keys, ctx->dict.nargs * 2,
+			    cap * 2, sizeof(struct __wimey_key_block))
+	    || !__wimey_resize(ctx, (void **)&ctx->dict.setters, ctx->dict.nargs,
+			       cap, sizeof(__wimey_setter_fn))
+	    || !__wimey_resize(ctx, (void **)&ctx->dict.hot, ctx->dict.nargs,
+			       cap, sizeof(struct __wimey_arg_hot)))
+		return false;
 
-			if (node->cmd.has_value && !overflow) {
-				if (!__wimey_is_str_a_command(argv[arg_i + 1])) {
+	ctx->dict.keys_cap = cap;
+	return true;
+}
 
-					__wimey_process_command(node,
-								argv[arg_i +
-								     1]);
-					arg_i++;
-					//    return WIMEY_OK;
-					continue;
-				}
+/* Parent level of a command level */
+static uint32_t __wimey_parent_level(struct wimey_ctx *ctx, uint32_t level) {
+	return level != 0 ? ctx->dict.cmds[level - 1].level : 0;
+}
+
+/* `key` is the first word of the path `word` */
+static const char *__wimey_command_word_of(void *node, const char *word) {
+	const char *key = ((struct __wimey_command_node *)node)->cmd.key;
+	size_t len = strcspn(word, " ");
+
+	return strncmp(key, word, len) == 0 && key[len] == '\0' ? key : NULL;
+}
+
+/* Resolve a command path like "remote add" to its level,
+ * every word is looked up among the children of the previous
+ * one. Returns false if a command of the path is missing. */
+static bool __wimey_resolve_path(struct wimey_ctx *ctx, const char *path, uint32_t *level) {
+	*level = 0;
+
+	while (path != NULL && *path != '\0') {
+		size_t len = strcspn(path, " ");
+		size_t i;
+
+		if (ctx->dict.sealed) {
+			struct __wimey_command_node *node =
+			    __wimey_index_probe(ctx, ctx->dict.cmd_slots, ctx->dict.cmd_mask,
+						*level, __wimey_hash_until(path, ' '), path,
+						__wimey_command_word_of);
+
+			if (node == NULL)
+				return false;
+			i = node - ctx->dict.cmds;
+		} else {
+			for (i = 0; i < ctx->dict.ncmds; i++) {
+				const char *key = ctx->dict.cmds[i].cmd.key;
+
+				if (ctx->dict.cmds[i].level == *level && key != NULL
+				    && strncmp(key, path, len) == 0 && key[len] == '\0')
+					break;
 			}
 
-			__wimey_process_command(node, NULL);
-			//return WIMEY_OK;
-			continue;
+			if (i == ctx->dict.ncmds)
+				return false;
 		}
+
+		*level = i + 1;
+		path += len;
+		path += strspn(path, " ");
+	}
+
+	return true;
+}
+
+/* Adds a new command to the commands list */
+int wimey_ctx_add_command(struct wimey_ctx *ctx, struct wimey_command_t cmd) {
+	if (ctx->dict.sealed) {
+		ERR(ctx, "Failed to add command %s, registry is sealed", cmd.key);
+		return WIMEY_ERR;
+	}
+
+	uint32_t level;
+
+	if (!__wimey_resolve_path(ctx, cmd.parent, &level)) {
+		ERR(ctx, "Failed to add command %s, unknown parent `%s`", cmd.key, cmd.parent);
+		return WIMEY_ERR;
+	}
+
+	struct __wimey_command_node *new_cmd = __wimey_command_slot(ctx);
+
+	if (!new_cmd) {
+		ERR(ctx, "Failed to allocate command.");
+		return WIMEY_ERR;
 	}
 
+	new_cmd->cmd = cmd;
+	new_cmd->next = NULL;
+	new_cmd->level = level;
+	new_cmd->children = 0;
+
+	if (level != 0)
+		ctx->dict.cmds[level - 1].children++;
+
+	if (ctx->dict.ncmds > 0)
+		ctx->dict.cmds[ctx->dict.ncmds - 1].next = new_cmd;
+
+	ctx->dict.ncmds++;
 	return WIMEY_OK;
-err:
-	ERR("Error during command parsing, invalid input");
-	return WIMEY_ERR;
 }
 
-/* --------------- Argument functions ------------- */
+/* Returns the head of the commands list
+ * or NULL if the list is empty */
+struct __wimey_command_node *wimey_ctx_get_commands_head(struct wimey_ctx *ctx) {
+	return ctx->dict.ncmds > 0 ? ctx->dict.cmds : NULL;
+}
+
+/* Given a string returns the command node among the children
+ * of `level` (parent position + 1, 0 for top level commands).
+ * A leaf has no children, its siblings are looked up instead */
+static struct __wimey_command_node
+*__wimey_get_command_node(struct wimey_ctx *ctx, uint32_t level, char *str) {
+	while (level != 0 && ctx->dict.cmds[level - 1].children == 0)
+		level = ctx->dict.cmds[level - 1].level;
+
+	if (ctx->dict.sealed)
+		return __wimey_index_find(ctx, ctx->dict.cmd_slots,
+					  ctx->dict.cmd_mask, level, str,
+					  __wimey_command_key_of);
+
+	struct __wimey_command_node *current = wimey_ctx_get_commands_head(ctx);
 
-/* This function get as parameter wimey_argument_t
- * and put it into a new allocated node, essentialy
- * a "next" pointer and our value (wimey_argument_t) */
-struct __wimey_argument_node
-*wimey_create_argument_node(struct wimey_argument_t new_arg) {
-	struct __wimey_argument_node *new_node =
-	    (struct __wimey_argument_node
-	     *)(malloc(sizeof(struct __wimey_argument_node)));
-
-	if (!new_node) {
-		ERR("Argument allocation failed");
+	if (current == NULL)
 		return NULL;
+
+	while (current != NULL) {
+		if (current->level == level) {
+			bool is_valid_key = strcmp(str, current->cmd.key);
+
+			__WIMEY_STAT(ctx, key_compares, 1);
+			if (is_valid_key == 0)
+				return current;
+		}
+
+		current = current->next;
 	}
 
-	memset(new_node, 0, sizeof(*new_node));
+	return NULL;
+}
+
+/* Given a string returns if it's a valid top level command  */
+bool __wimey_check_command(struct wimey_ctx *ctx, char *str) {
+	return __wimey_get_command_node(ctx, 0, str) != NULL;
+}
+
+/* Process a specific command with its value if needed */
+bool __wimey_process_command(struct wimey_ctx *ctx,
+			     const struct wimey_command_t *cmd, char *value) {
+	INFO(ctx, "Found command: %s", cmd->key);
+
+	if (cmd->callback == NULL)
+		return true;
+
+	if (cmd->has_value) {
+		cmd->callback(value);
+		return true;
+	}
 
-	new_node->argument = new_arg;
-	new_node->next = NULL;
-	return new_node;
+	cmd->callback(NULL);
+	return true;
 }
 
+/* --------------- Argument functions ------------- */
+
 /* Add argument to arguments dynamic list */
-int wimey_add_argument(struct wimey_argument_t argument) {
+int wimey_ctx_add_argument(struct wimey_ctx *ctx, struct wimey_argument_t argument) {
+	if (ctx->dict.sealed) {
+		ERR(ctx, "Failed to add argument %s, registry is sealed",
+		    argument.long_key);
+		return WIMEY_ERR;
+	}
 
 	/* If argument has no value or value isn't required
 	 * we set type as bool. For example --help argument
@@ -365,350 +1135,5462 @@ int wimey_add_argument(struct wimey_argument_t argument) {
 	 *      Output: Help for Banana
 	 *          ...
 	 */
+	if (__wimey_is_list(argument.value_type) || argument.value_type == WIMEY_CUSTOM) {
+		argument.has_value = true;
+		argument.is_value_required = true;
+	}
+
+	if (argument.value_type == WIMEY_CUSTOM && argument.parse_fn == NULL) {
+		ERR(ctx, "Failed to add argument %s, WIMEY_CUSTOM needs a parse_fn",
+		    argument.long_key);
+		return WIMEY_ERR;
+	}
+
 	if (!argument.is_value_required || !argument.has_value) {
 		argument.value_type = WIMEY_BOOL;
 		argument.is_value_required = true;
 		argument.has_value = true;
 	}
 
-	struct __wimey_argument_node *new_arg =
-	    wimey_create_argument_node(argument);
+	uint32_t level;
 
-	if (!new_arg) {
-		ERR("Failed to append new argument, invalid argument.");
+	if (!__wimey_resolve_path(ctx, argument.command, &level)) {
+		ERR(ctx, "Failed to add argument %s, unknown command `%s`",
+		    argument.long_key, argument.command);
 		return WIMEY_ERR;
 	}
 
-	if (wimey_dict.args_head == NULL) {
-		wimey_dict.args_head = new_arg;
-		return WIMEY_OK;
+	struct __wimey_argument_node *new_arg = __wimey_argument_slot(ctx);
+
+	if (!new_arg || !__wimey_argument_data_reserve(ctx)) {
+		ERR(ctx, "Argument allocation failed");
+		return WIMEY_ERR;
 	}
 
-	struct __wimey_argument_node *current = wimey_dict.args_head;
+	new_arg->argument = argument;
+	new_arg->next = NULL;
+	new_arg->level = level;
 
-	while (current->next != NULL) {
-		current = current->next;
-	}
+	__wimey_key_pack(&ctx->dict.arg_keys[ctx->dict.nargs * 2], argument.long_key);
+	__wimey_key_pack(&ctx->dict.arg_keys[ctx->dict.nargs * 2 + 1], argument.short_key);
+	ctx->dict.setters[ctx->dict.nargs] = __wimey_setter_of(&new_arg->argument);
+	__wimey_hot_set(&ctx->dict.hot[ctx->dict.nargs], new_arg);
 
-	current->next = new_arg;
+	if (__wimey_is_list(argument.value_type))
+		ctx->dict.nlists++;
+
+	if (ctx->dict.nargs > 0)
+		ctx->dict.args[ctx->dict.nargs - 1].next = new_arg;
+
+	ctx->dict.nargs++;
 	return WIMEY_OK;
 }
 
 /* Internal function to get the arguments head node 
  * but also avaible as public out of the library to iterate
  * the list of args  */
-struct __wimey_argument_node *wimey_get_arguments_head(void) {
-	return wimey_dict.args_head;
+struct __wimey_argument_node *wimey_ctx_get_arguments_head(struct wimey_ctx *ctx) {
+	return ctx->dict.nargs > 0 ? ctx->dict.args : NULL;
 }
 
-/* Get the node of a specific argument given by string */
+/* Get the node of a specific argument given by string, among
+ * the arguments visible at command `level`: the ones of that
+ * command, then of its parents up to the global ones.
+ * Unsealed, the token is packed once and matched against the
+ * key blocks, strcmp() only runs on keys longer than 15. */
 static struct __wimey_argument_node
-*__wimey_get_argument_node(char *str) {
-	struct __wimey_argument_node *current = wimey_get_arguments_head();
+*__wimey_get_argument_node(struct wimey_ctx *ctx, uint32_t level, char *str) {
+	struct __wimey_key_block tok;
+
+	if (!ctx->dict.sealed)
+		__wimey_key_pack(&tok, str);
+
+	for (;;) {
+		if (ctx->dict.sealed) {
+			struct __wimey_argument_node *node =
+			    __wimey_index_find(ctx, ctx->dict.arg_slots,
+					       ctx->dict.arg_mask, level, str,
+					       __wimey_argument_key_of);
+			if (node != NULL)
+				return node;
+		} else {
+			const struct __wimey_key_block *keys = ctx->dict.arg_keys;
+			const struct __wimey_arg_hot *hot = ctx->dict.hot;
+
+			for (size_t i = 0; i < ctx->dict.nargs; i++) {
+				struct __wimey_argument_node *current = &ctx->dict.args[i];
+
+				if (hot[i].level != level)
+					continue;
 
-	if (current == NULL)
-		return NULL;
+				__WIMEY_STAT(ctx, key_compares, 2);
+				if (__wimey_key_match(&keys[i * 2], &current->argument.long_key, &tok, str)
+				    || __wimey_key_match(&keys[i * 2 + 1], &current->argument.short_key,
+							 &tok, str))
+					return current;
+			}
+		}
 
-	while (current != NULL) {
-		bool is_valid_lkey = strcmp(str, current->argument.long_key);
-		bool is_valid_skey = strcmp(str, current->argument.short_key);
+		if (level == 0)
+			return NULL;
+		level = __wimey_parent_level(ctx, level);
+	}
+}
 
-		if (is_valid_lkey == 0 || is_valid_skey == 0)
-			return current;
+/* Returns the string to store for a WIMEY_STR value
+ * following ctx->conf.str_mode, NULL on failure */
+static char *__wimey_store_str(struct wimey_ctx *ctx, char *val) {
+	switch (ctx->conf.str_mode) {
+	case WIMEY_STR_BORROW:
+		return val;
+	case WIMEY_STR_BUFFER: {
+		size_t len = strlen(val) + 1;
+
+		if (ctx->conf.str_buf == NULL
+		    || ctx->conf.str_buf_len - ctx->str_used < len) {
+			ERR(ctx, "String buffer too small for value: %s", val);
+			__wimey_fail(ctx, WIMEY_E_NO_MEMORY, NULL, val);
+			return NULL;
+		}
 
-		current = current->next;
+		char *dst = ctx->conf.str_buf + ctx->str_used;
+		memcpy(dst, val, len);
+		ctx->str_used += len;
+		return dst;
+	}
+	default: {
+		char *dup = strdup(val);
+
+		__WIMEY_STAT(ctx, allocations, 1);
+		if (dup == NULL) {
+			ERR(ctx, "Failed to allocate value: %s", val);
+			__wimey_fail(ctx, WIMEY_E_NO_MEMORY, NULL, val);
+		}
+		return dup;
+	}
+	}
+}
+
+/* Arguments registered with wimey_add_argument() are already
+ * normalized, entries of static tables are not: an argument
+ * without a required value behaves as a boolean flag */
+static bool __wimey_is_flag(const struct wimey_argument_t *arg) {
+	return arg->value_type == WIMEY_BOOL
+	    || !arg->has_value || !arg->is_value_required;
+}
+
+/* ------- Lists ------- */
+
+/* Items of a value: numeric lists are comma separated,
+ * every occurrence of a WIMEY_STR_LIST is one item */
+static size_t __wimey_list_items(enum wimey_argument_type type, const char *val) {
+	size_t n = 1;
+
+	if (val == NULL)
+		return 0;
+	if (type == WIMEY_STR_LIST)
+		return 1;
+
+	for (; *val != '\0'; val++)
+		n += *val == ',';
+	return n;
+}
+
+/* Returns the slot of the list stored at `dest`, a new
+ * empty one if it's the first time `dest` is seen */
+static struct __wimey_list_slot *__wimey_list_slot(struct wimey_ctx *ctx,
+						   struct wimey_list_t *dest) {
+	for (size_t i = 0; i < ctx->lists.nslots; i++)
+		if (ctx->lists.slots[i].dest == dest)
+			return &ctx->lists.slots[i];
+
+	if (ctx->lists.nslots == ctx->lists.cap) {
+		size_t cap = ctx->lists.cap ? ctx->lists.cap * 2 : 4;
+
+		if (!__wimey_resize(ctx, (void **)&ctx->lists.slots, ctx->lists.nslots,
+				    cap, sizeof(struct __wimey_list_slot)))
+			return NULL;
+		ctx->lists.cap = cap;
+	}
+
+	struct __wimey_list_slot *slot = &ctx->lists.slots[ctx->lists.nslots++];
+
+	slot->dest = dest;
+	slot->block = NULL;
+	slot->cap = 0;
+	slot->gen = ctx->lists.gen;
+	dest->items = NULL;
+	dest->count = 0;
+	return slot;
+}
+
+/* Make room for `n` more items in the list of the current
+ * source, a list of an older source is emptied first. A
+ * prescanned list already has the room, so nothing moves. */
+static bool __wimey_list_reserve(struct wimey_ctx *ctx, struct __wimey_list_slot *slot,
+				 size_t n) {
+	struct wimey_list_t *dest = slot->dest;
+
+	if (slot->gen != ctx->lists.gen) {
+		slot->gen = ctx->lists.gen;
+		dest->items = (char *)slot->block
+			      + (-(uintptr_t)slot->block & (__WIMEY_LIST_ALIGN - 1));
+		dest->count = 0;
+	}
+
+	if (dest->count + n <= slot->cap)
+		return true;
+
+	size_t cap = dest->count + n;
+	char *block = __WIMEY_ALLOC(ctx, cap * __WIMEY_LIST_ITEM + __WIMEY_LIST_ALIGN - 1);
+
+	if (block == NULL) {
+		ERR(ctx, "Failed to allocate list of %zu items", cap);
+		__wimey_fail(ctx, WIMEY_E_NO_MEMORY, NULL, NULL);
+		return false;
+	}
+
+	char *items = block + (-(uintptr_t)block & (__WIMEY_LIST_ALIGN - 1));
+
+	if (dest->count > 0)
+		memcpy(items, dest->items, dest->count * __WIMEY_LIST_ITEM);
+	if (slot->block != NULL)
+		__WIMEY_FREE(ctx, slot->block);
+
+	slot->block = block;
+	slot->cap = cap;
+	dest->items = items;
+	return true;
+}
+
+/* Append the items of `val` to a list argument. Numbers are
+ * converted in place with the wimey_val_parse_* converters,
+ * strings follow str_mode unless `borrow` */
+static bool __wimey_list_push(struct wimey_ctx *ctx, const struct wimey_argument_t *arg,
+			      char *val, bool borrow) {
+	struct __wimey_list_slot *slot = __wimey_list_slot(ctx, arg->value_dest);
+
+	if (slot == NULL
+	    || !__wimey_list_reserve(ctx, slot, __wimey_list_items(arg->value_type, val)))
+		return false;
+
+	struct wimey_list_t *dest = slot->dest;
+
+	if (arg->value_type == WIMEY_STR_LIST) {
+		char *str = borrow ? val : __wimey_store_str(ctx, val);
+
+		if (str == NULL)
+			return false;
+		((char **)dest->items)[dest->count++] = str;
+		return true;
+	}
+
+	for (const char *item = val;; item++) {
+		size_t len = strcspn(item, ",");
+		char num[64];
+		int ok;
+
+		if (len >= sizeof(num))
+			goto conv_err;
+
+		memcpy(num, item, len);
+		num[len] = '\0';
+
+		__WIMEY_STAT(ctx, conversions, 1);
+		if (arg->value_type == WIMEY_LONG_LIST)
+			ok = wimey_val_parse_long(num, &((long *)dest->items)[dest->count]);
+		else
+			ok = wimey_val_parse_double(num, &((double *)dest->items)[dest->count]);
+
+		if (ok != WIMEY_OK)
+			goto conv_err;
+		dest->count++;
+
+		item += len;
+		if (*item == '\0')
+			break;
+	}
+
+	return true;
+
+conv_err:
+	ERR(ctx, "Invalid value `%s` for %s", val, arg->long_key);
+	__wimey_fail(ctx, WIMEY_E_INVALID_VALUE, arg->long_key, val);
+	return false;
+}
+
+/* Release the buffers of every list, the wimey_list_t
+ * destinations are left alone: they may be gone already */
+static void __wimey_lists_free(struct wimey_ctx *ctx) {
+	for (size_t i = 0; i < ctx->lists.nslots; i++)
+		if (ctx->lists.slots[i].block != NULL)
+			__WIMEY_FREE(ctx, ctx->lists.slots[i].block);
+
+	if (ctx->lists.slots != NULL)
+		__WIMEY_FREE(ctx, ctx->lists.slots);
+
+	ctx->lists.slots = NULL;
+	ctx->lists.nslots = ctx->lists.cap = 0;
+}
+
+/* Setters, one per kind of destination */
+static bool __wimey_conv_err(struct wimey_ctx *ctx, const struct wimey_argument_t *arg,
+			     char *val) {
+	ERR(ctx, "Invalid value `%s` for %s", val, arg->long_key);
+	__wimey_fail(ctx, WIMEY_E_INVALID_VALUE, arg->long_key, val);
+	return false;
+}
+
+static bool __wimey_set_flag(struct wimey_ctx *ctx, const struct wimey_argument_t *arg,
+			     char *val) {
+	(void)ctx;
+	(void)val;
+	*(int *)arg->value_dest = true;
+	return true;
+}
+
+static bool __wimey_set_long(struct wimey_ctx *ctx, const struct wimey_argument_t *arg,
+			     char *val) {
+	__WIMEY_STAT(ctx, conversions, 1);
+	if (wimey_val_parse_long(val, (long *)arg->value_dest) != WIMEY_OK)
+		return __wimey_conv_err(ctx, arg, val);
+	return true;
+}
+
+static bool __wimey_set_double(struct wimey_ctx *ctx, const struct wimey_argument_t *arg,
+			       char *val) {
+	__WIMEY_STAT(ctx, conversions, 1);
+	if (wimey_val_parse_double(val, (double *)arg->value_dest) != WIMEY_OK)
+		return __wimey_conv_err(ctx, arg, val);
+	return true;
+}
+
+static bool __wimey_set_str(struct wimey_ctx *ctx, const struct wimey_argument_t *arg,
+			    char *val) {
+	val = __wimey_store_str(ctx, val);
+	if (val == NULL)
+		return false;
+
+	*(char **)arg->value_dest = val;
+	return true;
+}
+
+static bool __wimey_set_list(struct wimey_ctx *ctx, const struct wimey_argument_t *arg,
+			     char *val) {
+	return __wimey_list_push(ctx, arg, val, false);
+}
+
+/* Values of user defined types, `parse_fn` may be bound later */
+static bool __wimey_set_custom(struct wimey_ctx *ctx, const struct wimey_argument_t *arg,
+			       char *val) {
+	if (arg->parse_fn == NULL) {
+		ERR(ctx, "Argument %s has no parse_fn", arg->long_key);
+		return false;
+	}
+
+	__WIMEY_STAT(ctx, conversions, 1);
+	if (arg->parse_fn(val, arg->value_dest) != WIMEY_OK)
+		return __wimey_conv_err(ctx, arg, val);
+	return true;
+}
+
+static bool __wimey_set_invalid(struct wimey_ctx *ctx, const struct wimey_argument_t *arg,
+				char *val) {
+	(void)arg;
+	(void)val;
+	ERR(ctx, "Failed to resolve argument type");
+	return false;
+}
+
+/* Pick the setter of an argument by its type, the only
+ * place the type is looked at when storing values */
+static __wimey_setter_fn __wimey_setter_of(const struct wimey_argument_t *arg) {
+	if (__wimey_is_flag(arg))
+		return __wimey_set_flag;
+
+	switch (arg->value_type) {
+	case WIMEY_LONG:
+		return __wimey_set_long;
+	case WIMEY_DOUBLE:
+		return __wimey_set_double;
+	case WIMEY_STR:
+		return __wimey_set_str;
+	case WIMEY_LONG_LIST:
+	case WIMEY_DOUBLE_LIST:
+	case WIMEY_STR_LIST:
+		return __wimey_set_list;
+	case WIMEY_CUSTOM:
+		return __wimey_set_custom;
+	default:
+		return __wimey_set_invalid;
+	}
+}
+
+/* Store the value of a registered argument in its destination
+ * with the setter resolved when it was added, returns false if
+ * the value can't be assigned */
+static bool __wimey_process_argument(struct wimey_ctx *ctx,
+				     const struct wimey_argument_t *arg,
+				     char *val) {
+	if (arg->value_dest == NULL)
+		return true;
+
+	/* `argument` is the first member of the node */
+	return ctx->dict.setters[(const struct __wimey_argument_node *)arg - ctx->dict.args]
+		(ctx, arg, val);
+}
+
+/* ------- Constraints ------- */
+
+/* Release the compiled constraints, config file marks stay */
+static void __wimey_rules_free(struct wimey_ctx *ctx) {
+	if (ctx->rules.required != NULL)
+		__WIMEY_FREE(ctx, ctx->rules.required);
+
+	ctx->rules.required = NULL;
+	ctx->rules.ruled = NULL;
+	ctx->rules.seen = NULL;
+	ctx->rules.rows = NULL;
+	ctx->rules.row_of = NULL;
+	ctx->rules.words = 0;
+	ctx->rules.nargs = 0;
+}
+
+/* Argument named by the `len` bytes at `word` (long or short
+ * key): the one visible at command `level` first, then any */
+static struct __wimey_argument_node *__wimey_rules_target(struct wimey_ctx *ctx,
+							  uint32_t level,
+							  const char *word, size_t len) {
+	struct __wimey_argument_node *any = NULL;
+
+	for (;;) {
+		for (size_t i = 0; i < ctx->dict.nargs; i++) {
+			struct __wimey_argument_node *node = &ctx->dict.args[i];
+			const char *l = node->argument.long_key, *s = node->argument.short_key;
+
+			if (!(l != NULL && strncmp(l, word, len) == 0 && l[len] == '\0')
+			    && !(s != NULL && strncmp(s, word, len) == 0 && s[len] == '\0'))
+				continue;
+			if (node->level == level)
+				return node;
+			if (any == NULL)
+				any = node;
+		}
+
+		if (level == 0)
+			return any;
+		level = ctx->dict.cmds[level - 1].level;
+	}
+}
+
+/* Set in `row` the bit of every key of the space separated
+ * `keys` of argument `i` */
+static bool __wimey_rules_fill(struct wimey_ctx *ctx, size_t i, const char *keys,
+			       uint64_t *row) {
+	const struct __wimey_argument_node *node = &ctx->dict.args[i];
+
+	for (const char *p = keys; p != NULL && *p != '\0';) {
+		size_t len = strcspn(p, " ");
+
+		if (len > 0) {
+			const struct __wimey_argument_node *target =
+			    __wimey_rules_target(ctx, node->level, p, len);
+
+			if (target == NULL) {
+				ERR(ctx, "Unknown key `%.*s` in the constraints of %s",
+				    (int)len, p, node->argument.long_key);
+				__wimey_fail(ctx, WIMEY_E_UNKNOWN_KEY, node->argument.long_key, NULL);
+				return false;
+			}
+
+			size_t t = target - ctx->dict.args;
+
+			row[t / 64] |= (uint64_t)1 << (t % 64);
+		}
+
+		p += len;
+		p += *p == ' ';
+	}
+
+	return true;
+}
+
+/* Compile the constraints of the registry, one block for all
+ * the bitsets. Nothing is allocated when no argument has any,
+ * parses then skip every step below. */
+static bool __wimey_rules_compile(struct wimey_ctx *ctx) {
+	size_t nargs = ctx->dict.nargs;
+	size_t words = (nargs + 63) / 64;
+	size_t nrows = 0, nrequired = 0;
+
+	__wimey_rules_free(ctx);
+
+	for (size_t i = 0; i < nargs; i++) {
+		const struct wimey_argument_t *arg = &ctx->dict.args[i].argument;
+
+		nrows += arg->requires != NULL || arg->conflicts != NULL;
+		nrequired += arg->required != 0;
+	}
+
+	if (nrows == 0 && nrequired == 0) {
+		ctx->rules.nargs = nargs;
+		return true;
+	}
+
+	size_t size = (3 + 2 * nrows) * words * sizeof(uint64_t) + nargs * sizeof(uint32_t);
+	uint64_t *block = __WIMEY_ALLOC(ctx, size);
+
+	if (block == NULL) {
+		ERR(ctx, "Failed to allocate the argument constraints");
+		__wimey_fail(ctx, WIMEY_E_NO_MEMORY, NULL, NULL);
+		return false;
+	}
+
+	memset(block, 0, size);
+	ctx->rules.required = block;
+	ctx->rules.ruled = block + words;
+	ctx->rules.seen = block + 2 * words;
+	ctx->rules.rows = block + 3 * words;
+	ctx->rules.row_of = (uint32_t *)(ctx->rules.rows + 2 * nrows * words);
+	ctx->rules.words = words;
+
+	for (size_t i = 0, row = 0; i < nargs; i++) {
+		const struct wimey_argument_t *arg = &ctx->dict.args[i].argument;
+		uint64_t bit = (uint64_t)1 << (i % 64);
+
+		if (arg->required)
+			ctx->rules.required[i / 64] |= bit;
+		if (arg->requires == NULL && arg->conflicts == NULL)
+			continue;
+
+		uint64_t *r = ctx->rules.rows + row * 2 * words;
+
+		ctx->rules.ruled[i / 64] |= bit;
+		ctx->rules.row_of[i] = ++row;
+		if (!__wimey_rules_fill(ctx, i, arg->requires, r)
+		    || !__wimey_rules_fill(ctx, i, arg->conflicts, r + words)) {
+			__wimey_rules_free(ctx);
+			return false;
+		}
+	}
+
+	ctx->rules.nargs = nargs;
+	return true;
+}
+
+/* Start the constraints of a parse: compile them if arguments
+ * were added since, then the arguments set by config files are
+ * the ones given so far */
+static bool __wimey_rules_begin(struct wimey_ctx *ctx) {
+	if (ctx->rules.nargs != ctx->dict.nargs && !__wimey_rules_compile(ctx))
+		return false;
+	if (ctx->rules.seen == NULL)
+		return true;
+
+	size_t n = ctx->rules.preset_words < ctx->rules.words
+		 ? ctx->rules.preset_words : ctx->rules.words;
+
+	memset(ctx->rules.seen, 0, ctx->rules.words * sizeof(uint64_t));
+	if (n > 0)
+		memcpy(ctx->rules.seen, ctx->rules.preset, n * sizeof(uint64_t));
+	return true;
+}
+
+/* Argument `i` of the registry was given */
+static void __wimey_rules_mark(struct wimey_ctx *ctx, size_t i) {
+	if (ctx->rules.seen != NULL && i < ctx->rules.nargs)
+		ctx->rules.seen[i / 64] |= (uint64_t)1 << (i % 64);
+}
+
+/* Argument `i` of the registry was set by a config file, the
+ * mark lasts like the value, until wimey_free_all() */
+static bool __wimey_rules_preset(struct wimey_ctx *ctx, size_t i) {
+	if (i / 64 >= ctx->rules.preset_words) {
+		size_t words = (ctx->dict.nargs + 63) / 64;
+		uint64_t *preset = __WIMEY_ALLOC(ctx, words * sizeof(uint64_t));
+
+		if (preset == NULL) {
+			ERR(ctx, "Failed to allocate the argument constraints");
+			__wimey_fail(ctx, WIMEY_E_NO_MEMORY, NULL, NULL);
+			return false;
+		}
+
+		memset(preset, 0, words * sizeof(uint64_t));
+		if (ctx->rules.preset != NULL) {
+			memcpy(preset, ctx->rules.preset, ctx->rules.preset_words * sizeof(uint64_t));
+			__WIMEY_FREE(ctx, ctx->rules.preset);
+		}
+		ctx->rules.preset = preset;
+		ctx->rules.preset_words = words;
+	}
+
+	ctx->rules.preset[i / 64] |= (uint64_t)1 << (i % 64);
+	return true;
+}
+
+/* If command `path` (a level) is `level` or one of its parents */
+static bool __wimey_level_on_path(struct wimey_ctx *ctx, uint32_t level, uint32_t path) {
+	for (;;) {
+		if (path == level)
+			return true;
+		if (path == 0)
+			return false;
+		path = ctx->dict.cmds[path - 1].level;
+	}
+}
+
+/* Check the constraints against the arguments given, the parse
+ * ended at command `level`: a scoped argument is only required on
+ * its path. A few AND/NOT per word, and the rows of the given
+ * arguments with rules. */
+static bool __wimey_rules_check(struct wimey_ctx *ctx, uint32_t level) {
+	const uint64_t *seen = ctx->rules.seen;
+	size_t words = ctx->rules.words;
+
+	if (seen == NULL)
+		return true;
+
+	for (size_t w = 0; w < words; w++) {
+		for (uint64_t m = ctx->rules.required[w] & ~seen[w]; m != 0; m &= m - 1) {
+			const struct __wimey_argument_node *node =
+			    &ctx->dict.args[w * 64 + __builtin_ctzll(m)];
+
+			if (!__wimey_level_on_path(ctx, node->level, level))
+				continue;
+
+			ERR(ctx, "Argument %s is required", node->argument.long_key);
+			__wimey_fail(ctx, WIMEY_E_REQUIRED, node->argument.long_key, NULL);
+			return false;
+		}
+	}
+
+	for (size_t w = 0; w < words; w++) {
+		for (uint64_t m = ctx->rules.ruled[w] & seen[w]; m != 0; m &= m - 1) {
+			size_t i = w * 64 + __builtin_ctzll(m);
+			const uint64_t *row = ctx->rules.rows + (ctx->rules.row_of[i] - 1) * 2 * words;
+			const char *key = ctx->dict.args[i].argument.long_key;
+
+			for (size_t v = 0; v < words; v++) {
+				uint64_t need = row[v] & ~seen[v];
+				uint64_t clash = row[words + v] & seen[v];
+
+				if (need != 0) {
+					const char *other =
+					    ctx->dict.args[v * 64 + __builtin_ctzll(need)].argument.long_key;
+
+					ERR(ctx, "Argument %s requires %s", key, other);
+					__wimey_fail(ctx, WIMEY_E_REQUIRES, key, other);
+					return false;
+				}
+
+				if (clash != 0) {
+					const char *other =
+					    ctx->dict.args[v * 64 + __builtin_ctzll(clash)].argument.long_key;
+
+					ERR(ctx, "Arguments %s and %s can't be used together", key, other);
+					__wimey_fail(ctx, WIMEY_E_CONFLICT, key, other);
+					return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+/* ----------------- Tokenizer ------------------ */
+
+/* Every argv token is classified only once */
+enum __wimey_token_kind {
+	__WIMEY_TOK_VALUE,	/* anything not in the dictionary */
+	__WIMEY_TOK_COMMAND,	/* registered command key */
+	__WIMEY_TOK_LONG,	/* registered --long key */
+	__WIMEY_TOK_SHORT,	/* registered -s key */
+	__WIMEY_TOK_BUNDLE,	/* -abc, one character short keys */
+	__WIMEY_TOK_END		/* `--`, end of options */
+};
+
+/* The tokenizer reads keys through a schema: either the
+ * registry of `ctx` or the static tables given to
+ * wimey_parse_table(), optionally with a precomputed index */
+struct __wimey_schema {
+	struct wimey_ctx *ctx;
+	bool is_table;
+	const struct wimey_command_t *cmds;
+	const struct wimey_argument_t *args;
+	size_t ncmds;
+	size_t nargs;
+	const struct wimey_table_index_t *index;
+};
+
+/* Schema of the registry */
+static struct __wimey_schema __wimey_registry_schema(struct wimey_ctx *ctx) {
+	struct __wimey_schema schema = {
+		.ctx = ctx,
+		.is_table = false,
+		.ncmds = ctx->dict.ncmds,
+		.nargs = ctx->dict.nargs
+	};
+
+	return schema;
+}
+
+/* Returns the i-th command or argument of a schema */
+static const struct wimey_command_t
+*__wimey_schema_command(const struct __wimey_schema *schema, size_t i) {
+	return schema->is_table ? &schema->cmds[i]
+				: &schema->ctx->dict.cmds[i].cmd;
+}
+
+static const struct wimey_argument_t
+*__wimey_schema_argument(const struct __wimey_schema *schema, size_t i) {
+	return schema->is_table ? &schema->args[i]
+				: &schema->ctx->dict.args[i].argument;
+}
+
+static bool __wimey_key_eq(const char *key, const char *str) {
+	return key != NULL && strcmp(key, str) == 0;
+}
+
+/* Given a string returns the command of a schema at `level` or
+ * NULL, tables have no levels */
+static const struct wimey_command_t
+*__wimey_schema_find_command(const struct __wimey_schema *schema, uint32_t level,
+			     char *str) {
+	if (!schema->is_table) {
+		struct __wimey_command_node *node =
+		    __wimey_get_command_node(schema->ctx, level, str);
+		return node != NULL ? &node->cmd : NULL;
+	}
+
+	if (schema->index != NULL) {
+		size_t mask = schema->index->cmd_size - 1;
+		size_t i = __wimey_hash(str) & mask;
+
+		/* Slots hold table position + 1, 0 is empty */
+		while (schema->index->cmd_slots[i] != 0) {
+			const struct wimey_command_t *cmd =
+			    &schema->cmds[schema->index->cmd_slots[i] - 1];
+
+			if (__wimey_key_eq(cmd->key, str))
+				return cmd;
+			i = (i + 1) & mask;
+		}
+		return NULL;
+	}
+
+	for (size_t i = 0; i < schema->ncmds; i++)
+		if (__wimey_key_eq(schema->cmds[i].key, str))
+			return &schema->cmds[i];
+
+	return NULL;
+}
+
+/* Given a string returns the argument of a schema visible at
+ * `level` or NULL */
+static const struct wimey_argument_t
+*__wimey_schema_find_argument(const struct __wimey_schema *schema, uint32_t level,
+			      char *str) {
+	if (!schema->is_table) {
+		struct __wimey_argument_node *node =
+		    __wimey_get_argument_node(schema->ctx, level, str);
+		return node != NULL ? &node->argument : NULL;
+	}
+
+	if (schema->index != NULL) {
+		size_t mask = schema->index->arg_size - 1;
+		size_t i = __wimey_hash(str) & mask;
+
+		while (schema->index->arg_slots[i] != 0) {
+			const struct wimey_argument_t *arg =
+			    &schema->args[schema->index->arg_slots[i] - 1];
+
+			if (__wimey_key_eq(arg->long_key, str)
+			    || __wimey_key_eq(arg->short_key, str))
+				return arg;
+			i = (i + 1) & mask;
+		}
+		return NULL;
+	}
+
+	for (size_t i = 0; i < schema->nargs; i++)
+		if (__wimey_key_eq(schema->args[i].long_key, str)
+		    || __wimey_key_eq(schema->args[i].short_key, str))
+			return &schema->args[i];
+
+	return NULL;
+}
+
+/* Argument of a "--key=value" token, the key is compared up
+ * to the '=' so the token is not copied */
+static const struct wimey_argument_t
+*__wimey_schema_find_long_eq(const struct __wimey_schema *schema, uint32_t level,
+			     const char *tok) {
+	struct wimey_ctx *ctx = schema->ctx;
+
+	if (!schema->is_table) {
+		uint32_t hash = __wimey_hash_until(tok, '=');
+
+		/* Innermost command first, like __wimey_get_argument_node() */
+		for (;;) {
+			if (ctx->dict.sealed) {
+				struct __wimey_argument_node *node =
+				    __wimey_index_probe(ctx, ctx->dict.arg_slots, ctx->dict.arg_mask,
+							level, hash, tok, __wimey_long_key_eq_of);
+				if (node != NULL)
+					return &node->argument;
+			} else {
+				for (size_t i = 0; i < ctx->dict.nargs; i++) {
+					if (ctx->dict.args[i].level != level)
+						continue;
+
+					__WIMEY_STAT(ctx, key_compares, 1);
+					if (__wimey_long_key_eq_of(&ctx->dict.args[i], tok) != NULL)
+						return &ctx->dict.args[i].argument;
+				}
+			}
+
+			if (level == 0)
+				return NULL;
+			level = __wimey_parent_level(ctx, level);
+		}
+	}
+
+	if (schema->is_table && schema->index != NULL) {
+		size_t mask = schema->index->arg_size - 1;
+		size_t i = __wimey_hash_until(tok, '=') & mask;
+
+		while (schema->index->arg_slots[i] != 0) {
+			const struct wimey_argument_t *arg =
+			    &schema->args[schema->index->arg_slots[i] - 1];
+
+			if (__wimey_key_eq_until_eq(arg->long_key, tok))
+				return arg;
+			i = (i + 1) & mask;
+		}
+		return NULL;
+	}
+
+	for (size_t i = 0; i < schema->nargs; i++) {
+		const struct wimey_argument_t *arg = __wimey_schema_argument(schema, i);
+
+		__WIMEY_STAT(ctx, key_compares, 1);
+		if (__wimey_key_eq_until_eq(arg->long_key, tok))
+			return arg;
+	}
+
+	return NULL;
+}
+
+/* Argument of the short key "-c", a sealed registry at top
+ * level uses the direct table built by wimey_finalize() */
+static const struct wimey_argument_t
+*__wimey_schema_find_short(const struct __wimey_schema *schema, uint32_t level, char c) {
+	struct wimey_ctx *ctx = schema->ctx;
+
+	if (!schema->is_table && ctx->dict.sealed && level == 0) {
+		uint32_t pos = ctx->dict.shorts[(unsigned char)c];
+
+		return pos != 0 ? &ctx->dict.args[pos - 1].argument : NULL;
+	}
+
+	if (!schema->is_table) {
+		char key[3] = { '-', c, '\0' };
+
+		return __wimey_schema_find_argument(schema, level, key);
+	}
+
+	for (size_t i = 0; i < schema->nargs; i++) {
+		const struct wimey_argument_t *arg = __wimey_schema_argument(schema, i);
+
+		__WIMEY_STAT(ctx, key_compares, 1);
+		if (__wimey_is_short_char(arg->short_key) && arg->short_key[1] == c)
+			return arg;
+	}
+
+	return NULL;
+}
+
+/* Position of an argument in its schema: registry order
+ * or table order, used as column by the batch output */
+static size_t __wimey_schema_argument_index(const struct __wimey_schema *schema,
+					    const struct wimey_argument_t *arg) {
+	if (schema->is_table)
+		return arg - schema->args;
+
+	/* `argument` is the first member of the node */
+	return (const struct __wimey_argument_node *)arg - schema->ctx->dict.args;
+}
+
+/* Where the tokenizer sends what it matched: the usual
+ * destinations (callbacks and value_dest), a batch row or
+ * the lazy slots of the context */
+struct __wimey_sink {
+	struct wimey_batch_t *batch;	/* NULL: callbacks and value_dest */
+	size_t row;
+	bool lazy;	/* record arguments, don't convert */
+	bool delta;	/* re-parse: no command callbacks */
+	bool stream;	/* streamed lines: --help doesn't exit */
+};
+
+/* Record where the value of `arg` is, it's converted
+ * later by the wimey_get_*() accessors */
+static void __wimey_lazy_record(const struct __wimey_schema *schema,
+				const struct wimey_argument_t *arg, char *val) {
+	struct wimey_ctx *ctx = schema->ctx;
+	struct __wimey_lazy_slot *slot =
+		&ctx->lazy.slots[__wimey_schema_argument_index(schema, arg)];
+
+	slot->gen = ctx->lazy.gen;
+	slot->raw = val;
+	slot->state = __WIMEY_LAZY_RAW;
+}
+
+/* Lazy mode records the config file and environment values
+ * like argv ones, lists and custom types are converted anyway */
+static bool __wimey_lazy_keeps(const struct wimey_ctx *ctx,
+			       const struct wimey_argument_t *arg) {
+	return ctx->conf.lazy && !__wimey_is_list(arg->value_type)
+	    && arg->value_type != WIMEY_CUSTOM;
+}
+
+/* Set `slot` to the raw value `val` in generation `gen`, a
+ * generation 0 leaves the argument unset (a false flag) */
+static void __wimey_lazy_keep(struct __wimey_lazy_slot *slot, uint32_t gen, char *val) {
+	slot->gen = gen;
+	slot->raw = val;
+	slot->state = __WIMEY_LAZY_RAW;
+}
+
+/* Store an argument value in its batch cell, strings
+ * point into argv so nothing is allocated */
+static bool __wimey_batch_store(const struct __wimey_schema *schema,
+				const struct __wimey_sink *sink,
+				const struct wimey_argument_t *arg, char *val) {
+	struct wimey_batch_t *batch = sink->batch;
+	size_t cell = __wimey_schema_argument_index(schema, arg) * batch->rows
+		    + sink->row;
+
+	batch->seen[cell] = 1;
+
+	if (__wimey_is_flag(arg)) {
+		batch->values[cell].b = true;
+		return true;
+	}
+
+	if (arg->value_type == WIMEY_LONG || arg->value_type == WIMEY_DOUBLE)
+		__WIMEY_STAT(schema->ctx, conversions, 1);
+
+	int ok = WIMEY_OK;
+
+	switch (arg->value_type) {
+	case WIMEY_LONG:
+		ok = wimey_val_parse_long(val, &batch->values[cell].l);
+		break;
+	case WIMEY_DOUBLE:
+		ok = wimey_val_parse_double(val, &batch->values[cell].d);
+		break;
+	default:
+		batch->values[cell].s = val;
+		break;
+	}
+
+	if (ok != WIMEY_OK)
+		__wimey_fail(schema->ctx, WIMEY_E_INVALID_VALUE, arg->long_key, val);
+	return ok == WIMEY_OK;
+}
+
+/* Classify a token with a single dictionary lookup, tokens
+ * starting with '-' are only looked up as arguments, others only
+ * as commands. `entry` receives the matched command or argument,
+ * `inline_val` the value of a "--key=value" token.
+ * A "-abc" token that isn't a key is a bundle if its first
+ * character is a short key, `entry` is then that argument. */
+static enum __wimey_token_kind
+__wimey_classify_token(const struct __wimey_schema *schema, uint32_t level, char *tok,
+		       const void **entry, char **inline_val) {
+	*entry = NULL;
+	*inline_val = NULL;
+
+	if (tok[0] == '-') {
+		if (tok[1] == '-' && tok[2] == '\0')
+			return __WIMEY_TOK_END;
+
+		if (tok[1] == '-') {
+			char *eq = strchr(tok + 2, '=');
+
+			if (eq != NULL) {
+				*entry = __wimey_schema_find_long_eq(schema, level, tok);
+				if (*entry != NULL) {
+					*inline_val = eq + 1;
+					return __WIMEY_TOK_LONG;
+				}
+			}
+		}
+
+		*entry = __wimey_schema_find_argument(schema, level, tok);
+		if (*entry != NULL)
+			return tok[1] == '-' ? __WIMEY_TOK_LONG : __WIMEY_TOK_SHORT;
+
+		if (tok[1] != '-' && tok[1] != '\0' && tok[2] != '\0') {
+			*entry = __wimey_schema_find_short(schema, level, tok[1]);
+			if (*entry != NULL)
+				return __WIMEY_TOK_BUNDLE;
+		}
+
+		return __WIMEY_TOK_VALUE;
+	}
+
+	*entry = __wimey_schema_find_command(schema, level, tok);
+	return *entry != NULL ? __WIMEY_TOK_COMMAND : __WIMEY_TOK_VALUE;
+}
+
+/* Upper bound of the items argv gives to a list argument.
+ * Keys are matched as the tokenizer would ("--key", "--key=v",
+ * "-k" and "-k" in a bundle), scopes are ignored: a bound too
+ * large only costs a few bytes. */
+static size_t __wimey_list_prescan(const struct wimey_argument_t *arg,
+				   int argc, char **argv) {
+	const char *lkey = arg->long_key, *skey = arg->short_key;
+	size_t llen = lkey != NULL ? strlen(lkey) : 0;
+	size_t n = 0;
+
+	for (int i = 1; i < argc; i++) {
+		char *tok = argv[i], *next = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if (tok[0] != '-')
+			continue;
+		if (tok[1] == '-' && tok[2] == '\0')
+			break;
+
+		if (__wimey_key_eq(lkey, tok) || __wimey_key_eq(skey, tok)) {
+			n += __wimey_list_items(arg->value_type, next);
+		} else if (llen > 0 && strncmp(tok, lkey, llen) == 0 && tok[llen] == '=') {
+			n += __wimey_list_items(arg->value_type, tok + llen + 1);
+		} else if (tok[1] != '-' && __wimey_is_short_char(skey)) {
+			char *c = strchr(tok + 1, skey[1]);
+
+			if (c != NULL)
+				n += __wimey_list_items(arg->value_type, next)
+				   + __wimey_list_items(arg->value_type, c + 1);
+		}
+	}
+
+	return n;
+}
+
+/* Start the argv source of the lists: every list given in
+ * argv gets its whole buffer now, one allocation at most */
+static bool __wimey_lists_begin(const struct __wimey_schema *schema,
+				int argc, char **argv) {
+	struct wimey_ctx *ctx = schema->ctx;
+
+	ctx->lists.gen++;
+
+	if (!schema->is_table && ctx->dict.nlists == 0)
+		return true;
+
+	for (size_t i = 0; i < schema->nargs; i++) {
+		const struct wimey_argument_t *arg = __wimey_schema_argument(schema, i);
+		struct __wimey_list_slot *slot;
+		size_t n;
+
+		if (!__wimey_is_list(arg->value_type) || arg->value_dest == NULL)
+			continue;
+
+		n = __wimey_list_prescan(arg, argc, argv);
+		if (n == 0)
+			continue;
+
+		slot = __wimey_list_slot(ctx, arg->value_dest);
+		if (slot == NULL || !__wimey_list_reserve(ctx, slot, n))
+			return false;
+	}
+
+	return true;
+}
+
+/* Send a matched argument and its value (NULL for flags) to the
+ * sink, --help prints the help and exits unless in a batch (a
+ * stream goes on) */
+static bool __wimey_take_argument(const struct __wimey_schema *schema,
+				  const struct __wimey_sink *sink,
+				  const struct wimey_argument_t *arg, char *val,
+				  int argc, char **argv) {
+	struct wimey_ctx *ctx = schema->ctx;
+	bool stored = true;
+
+	if (sink->batch == NULL
+	    && (schema->is_table ? __wimey_key_eq(arg->long_key, help_arg.long_key)
+	        : ctx->dict.hot[__wimey_schema_argument_index(schema, arg)].flags
+		  & __WIMEY_HOT_HELP)) {
+		__wimey_print_help(schema, argc, argv);
+		if (!sink->stream)
+			exit(EXIT_SUCCESS);
+		return true;
+	}
+
+	if (sink->batch == NULL && !schema->is_table)
+		__wimey_rules_mark(ctx, __wimey_schema_argument_index(schema, arg));
+
+	__WIMEY_CYCLES(argument_start);
+	if (sink->batch != NULL)
+		stored = __wimey_batch_store(schema, sink, arg, val);
+	else if (sink->lazy && !__wimey_is_list(arg->value_type)
+		 && (arg->value_type != WIMEY_CUSTOM || sink->delta))
+		__wimey_lazy_record(schema, arg, val);
+	else if (schema->is_table)
+		stored = arg->value_dest == NULL || __wimey_setter_of(arg)(ctx, arg, val);
+	else
+		stored = __wimey_process_argument(ctx, arg, val);
+
+	__WIMEY_STAT_CYCLES(ctx, argument_cycles, argument_start);
+	(void)ctx;
+	return stored;
+}
+
+/* Optimal string alignment distance (Damerau-Levenshtein with
+ * adjacent transpositions) between the pattern of `peq`, `m`
+ * characters, and `text` of length `n`: Myers' bit-parallel
+ * algorithm with Hyyro's transposition term, one word per text
+ * character. The last row drops by at most one per character, so
+ * the scan stops as soon as it can't get back to `max`.
+ * Returns: the distance, or max + 1 if it's larger than `max` */
+static size_t __wimey_osa_distance(const uint64_t *peq, size_t m,
+				   const char *text, size_t n, size_t max) {
+	uint64_t vp = m == 64 ? UINT64_MAX : (1ull << m) - 1;
+	uint64_t vn = 0, d0 = 0, pm_prev = 0;
+	uint64_t last = 1ull << (m - 1);
+	size_t score = m;
+
+	for (size_t j = 0; j < n; j++) {
+		uint64_t pm = peq[(unsigned char)text[j]];
+		uint64_t tr = ((~d0 & pm) << 1) & pm_prev;
+
+		d0 = (((pm & vp) + vp) ^ vp) | pm | vn | tr;
+
+		uint64_t hp = vn | ~(d0 | vp);
+		uint64_t hn = vp & d0;
+
+		if (hp & last)
+			score++;
+		else if (hn & last)
+			score--;
+
+		if (score > max + (n - j - 1))
+			return max + 1;
+
+		uint64_t x = (hp << 1) | 1;
+
+		vn = x & d0;
+		vp = (hn << 1) | ~(x | d0);
+		pm_prev = pm;
+	}
+
+	return score <= max ? score : max + 1;
+}
+
+/* Edits allowed for a token by the length of its name (after
+ * the dashes), names shorter than 3 get no suggestion */
+static size_t __wimey_suggest_bound(size_t name) {
+	return name < 3 ? 0 : name <= 5 ? 1 : name <= 9 ? 2 : 3;
+}
+
+/* i-th key of a kind: commands (0), or long and short key of
+ * each argument (1) */
+static const char *__wimey_bucket_key(struct wimey_ctx *ctx, int kind, size_t i) {
+	if (kind == 0)
+		return ctx->dict.cmds[i].cmd.key;
+
+	return i % 2 == 0 ? ctx->dict.args[i / 2].argument.long_key
+			  : ctx->dict.args[i / 2].argument.short_key;
+}
+
+/* Group the keys of a kind of the sealed registry by length,
+ * a counting sort done once */
+static bool __wimey_buckets_build(struct wimey_ctx *ctx, int kind) {
+	struct __wimey_key_buckets *b = &ctx->dict.suggest[kind];
+	size_t n = kind == 0 ? ctx->dict.ncmds : ctx->dict.nargs * 2;
+	uint32_t at[__WIMEY_SUGGEST_MAX + 5];
+	size_t nb = __WIMEY_SUGGEST_MAX + 5;
+
+	if (b->keys != NULL)
+		return true;
+
+	b->keys = __WIMEY_ALLOC(ctx, (n > 0 ? n : 1) * sizeof(char *));
+	if (b->keys == NULL)
+		return false;
+
+	memset(b->starts, 0, sizeof(b->starts));
+	for (size_t i = 0; i < n; i++) {
+		const char *key = __wimey_bucket_key(ctx, kind, i);
+		size_t len = key != NULL ? strlen(key) : nb;
+
+		if (len + 1 < nb)
+			b->starts[len + 1]++;
+	}
+
+	for (size_t l = 1; l < nb; l++)
+		b->starts[l] += b->starts[l - 1];
+
+	memcpy(at, b->starts, sizeof(at));
+	for (size_t i = 0; i < n; i++) {
+		const char *key = __wimey_bucket_key(ctx, kind, i);
+		size_t len = key != NULL ? strlen(key) : nb;
+
+		if (len + 1 < nb)
+			b->keys[at[len]++] = key;
+	}
+
+	return true;
+}
+
+/* Keep `key` if it's closer to the token than the best so far,
+ * `max` then becomes one less than its distance. An exact match
+ * is a key of another scope, it isn't suggested. */
+static void __wimey_suggest_try(const uint64_t *peq, size_t m, const char *key,
+				size_t len, const char **best, size_t *max) {
+	if (key == NULL || len + *max < m || len > m + *max)
+		return;
+
+	size_t d = __wimey_osa_distance(peq, m, key, len, *max);
+
+	if (d != 0 && d <= *max) {
+		*best = key;
+		*max = d - 1;
+	}
+}
+
+/* Closest command (or argument) key to the first `m` characters
+ * of `tok`, for "did you mean" messages: only called once a token
+ * is unknown, so a successful parse never gets here. The sealed
+ * registry searches the keys whose length is within the bound,
+ * nearest lengths first, others every key after a length check.
+ * Returns: the key or NULL if none is close enough */
+static const char *__wimey_suggest(const struct __wimey_schema *schema, bool command,
+				   const char *tok, size_t m) {
+	struct wimey_ctx *ctx = schema->ctx;
+	size_t dashes = strspn(tok, "-");
+	size_t max = __wimey_suggest_bound(dashes < m ? m - dashes : 0);
+	const char *best = NULL;
+	uint64_t peq[256];
+
+	if (max == 0 || m > __WIMEY_SUGGEST_MAX)
+		return NULL;
+
+	memset(peq, 0, sizeof(peq));
+	for (size_t i = 0; i < m; i++)
+		peq[(unsigned char)tok[i]] |= 1ull << i;
+
+	if (!schema->is_table && ctx->dict.sealed && __wimey_buckets_build(ctx, !command)) {
+		const struct __wimey_key_buckets *b = &ctx->dict.suggest[!command];
+
+		for (size_t d = 0; d <= max; d++) {
+			for (int side = 0; side < 2 && d <= max; side++) {
+				size_t len = side == 0 ? m - d : m + d;
+
+				if ((side == 0 && d > m) || (side == 1 && d == 0)
+				    || len + 1 >= __WIMEY_SUGGEST_MAX + 5)
+					continue;
+
+				for (uint32_t i = b->starts[len]; i < b->starts[len + 1]; i++)
+					__wimey_suggest_try(peq, m, b->keys[i], len, &best, &max);
+			}
+		}
+
+		return best;
+	}
+
+	if (command) {
+		for (size_t i = 0; i < schema->ncmds; i++) {
+			const char *key = __wimey_schema_command(schema, i)->key;
+
+			if (key != NULL)
+				__wimey_suggest_try(peq, m, key, strlen(key), &best, &max);
+		}
+		return best;
+	}
+
+	for (size_t i = 0; i < schema->nargs; i++) {
+		const struct wimey_argument_t *arg = __wimey_schema_argument(schema, i);
+
+		if (arg->long_key != NULL)
+			__wimey_suggest_try(peq, m, arg->long_key, strlen(arg->long_key),
+					    &best, &max);
+		if (arg->short_key != NULL)
+			__wimey_suggest_try(peq, m, arg->short_key, strlen(arg->short_key),
+					    &best, &max);
+	}
+
+	return best;
+}
+
+/* Warn about a token nothing handles: an unknown "--key" always,
+ * other tokens only if a key is close to them (they may be values
+ * the program reads itself). Nothing is searched when warnings
+ * are off, nor in batches. */
+static void __wimey_warn_unknown(const struct __wimey_schema *schema,
+				 const struct __wimey_sink *sink, const char *tok) {
+	struct wimey_ctx *ctx = schema->ctx;
+	bool is_long = tok[0] == '-' && tok[1] == '-';
+	size_t m = is_long ? strcspn(tok, "=") : strlen(tok);
+	const char *hint;
+
+	if (ctx->conf.log_level < LOG_ERR_AND_WARNS || sink->batch != NULL)
+		return;
+
+	hint = __wimey_suggest(schema, tok[0] != '-', tok, m);
+	if (hint != NULL)
+		WARN(ctx, "Unknown %s %.*s, did you mean %s?",
+		     tok[0] == '-' ? "argument" : "command", (int)m, tok, hint);
+	else if (is_long)
+		WARN(ctx, "Unknown argument %.*s", (int)m, tok);
+}
+
+/* Internal function that walks argv once, every token is
+ * classified and sent to the command or argument handler.
+ * Values are consumed by the key that owns them, so they are
+ * never looked up again. Parsing stops at `--`.
+ * "--key=value" and bundles of short keys ("-abc", the last one
+ * may take the rest of the token or the next one as value) are
+ * split in place: values point into the token, nothing is copied. */
+static int __wimey_parse_tokens(const struct __wimey_schema *schema,
+				const struct __wimey_sink *sink,
+				int argc, char **argv) {
+	struct wimey_ctx *ctx = schema->ctx;
+
+	int arg_i = 1;
+
+	if (schema->ncmds > 0 && argc < 2) {
+		ERR(ctx, "Argc < 2, but commands exist in the dictionary");
+		__wimey_fail(ctx, WIMEY_E_NO_COMMAND, NULL, NULL);
+		goto err;
+	}
+
+	if (sink->batch == NULL && !__wimey_lists_begin(schema, argc, argv))
+		goto err;
+
+	/* One token lookahead, a command classifies the token after
+	 * it to know if it's its value: keep the result for the next
+	 * iteration instead of classifying the token twice */
+	int ahead_i = -1;
+	const void *ahead_entry = NULL;
+	char *ahead_val = NULL;
+	enum __wimey_token_kind ahead_kind = __WIMEY_TOK_VALUE;
+
+	/* Command level reached so far, a command with subcommands
+	 * narrows the lookups to its children and arguments */
+	uint32_t level = 0;
+
+	__WIMEY_STAT(ctx, parses, 1);
+
+	for (; arg_i < argc; arg_i++) {
+		const void *entry;
+		char *next = arg_i + 1 < argc ? argv[arg_i + 1] : NULL;
+		char *inline_val;
+		enum __wimey_token_kind kind;
+
+		__WIMEY_STAT(ctx, tokens, 1);
+		if (ahead_i == arg_i) {
+			kind = ahead_kind;
+			entry = ahead_entry;
+			inline_val = ahead_val;
+		} else {
+			__WIMEY_CYCLES(lookup_start);
+			kind = __wimey_classify_token(schema, level, argv[arg_i], &entry,
+						      &inline_val);
+			__WIMEY_STAT_CYCLES(ctx, lookup_cycles, lookup_start);
+		}
+
+		switch (kind) {
+		case __WIMEY_TOK_END:
+			goto done;
+
+		case __WIMEY_TOK_VALUE:
+			/* Unknown token, nothing handles it */
+			__wimey_warn_unknown(schema, sink, argv[arg_i]);
+			continue;
+
+		case __WIMEY_TOK_COMMAND: {
+			const struct wimey_command_t *cmd = entry;
+
+			/* Enter the command scope: its children and arguments
+			 * (the siblings too for a leaf, so flat commands chain) */
+			if (!schema->is_table) {
+				const struct __wimey_command_node *node = entry;
+
+				level = node - ctx->dict.cmds + 1;
+			}
+
+			if (cmd->is_value_required && next == NULL) {
+				ERR(ctx, "Command %s requires value `%s` but none provided",
+				    cmd->key, cmd->value_name);
+				__wimey_fail(ctx, WIMEY_E_MISSING_VALUE, cmd->key, NULL);
+				goto err;
+			}
+
+			/* The next token is the command value only if
+			 * it isn't a key itself */
+			if (cmd->has_value && next != NULL) {
+				__WIMEY_CYCLES(lookup_start);
+				ahead_i = arg_i + 1;
+				ahead_kind = __wimey_classify_token(schema, level, next,
+								    &ahead_entry, &ahead_val);
+				__WIMEY_STAT_CYCLES(ctx, lookup_cycles, lookup_start);
+			}
+
+			char *value = NULL;
+
+			if (cmd->has_value && next != NULL
+			    && ahead_kind == __WIMEY_TOK_VALUE) {
+				value = next;
+				arg_i++;
+				__WIMEY_STAT(ctx, tokens, 1);
+			}
+
+			/* Batches and re-parses only collect arguments */
+			if (sink->batch == NULL && !sink->delta) {
+				__WIMEY_CYCLES(command_start);
+				__wimey_process_command(ctx, cmd, value);
+				__WIMEY_STAT_CYCLES(ctx, command_cycles, command_start);
+			}
+			continue;
+		}
+
+		case __WIMEY_TOK_LONG:
+		case __WIMEY_TOK_SHORT: {
+			const struct wimey_argument_t *arg = entry;
+
+			if (inline_val != NULL) {
+				if (__wimey_is_flag(arg)) {
+					ERR(ctx, "Argument %s doesn't take a value", arg->long_key);
+					__wimey_fail(ctx, WIMEY_E_UNEXPECTED_VALUE, arg->long_key,
+						     inline_val);
+					goto err;
+				}
+				next = inline_val;
+			} else if (__wimey_is_flag(arg)) {
+				next = NULL;
+			} else {
+				/* The value is the next token, whatever it looks like */
+				if (next == NULL || strcmp(next, "--") == 0) {
+					ERR(ctx, "Argument %s requires value `%s` but none provided",
+					    arg->long_key, arg->value_name);
+					__wimey_fail(ctx, WIMEY_E_MISSING_VALUE, arg->long_key, NULL);
+					goto err;
+				}
+				arg_i++;
+				__WIMEY_STAT(ctx, tokens, 1);
+			}
+
+			if (!__wimey_take_argument(schema, sink, arg, next, argc, argv))
+				goto err;
+			continue;
+		}
+
+		case __WIMEY_TOK_BUNDLE: {
+			const struct wimey_argument_t *arg = entry;
+
+			for (char *p = argv[arg_i] + 1; *p != '\0'; p++) {
+				char *val = NULL;
+
+				if (arg == NULL)
+					arg = __wimey_schema_find_short(schema, level, *p);
+				if (arg == NULL) {
+					/* Often a long key typed with one dash */
+					const char *hint = sink->batch == NULL
+						? __wimey_suggest(schema, false, argv[arg_i],
+								  strlen(argv[arg_i]))
+						: NULL;
+
+					if (hint != NULL)
+						ERR(ctx, "Unknown flag -%c in %s, did you mean %s?",
+						    *p, argv[arg_i], hint);
+					else
+						ERR(ctx, "Unknown flag -%c in %s", *p, argv[arg_i]);
+					__wimey_fail(ctx, WIMEY_E_UNKNOWN_KEY, NULL, argv[arg_i]);
+					goto err;
+				}
+
+				/* A key with a value ends the bundle */
+				if (!__wimey_is_flag(arg)) {
+					if (p[1] != '\0') {
+						val = p + 1;
+					} else if (next == NULL || strcmp(next, "--") == 0) {
+						ERR(ctx, "Argument %s requires value `%s` but none provided",
+						    arg->long_key, arg->value_name);
+						__wimey_fail(ctx, WIMEY_E_MISSING_VALUE, arg->long_key,
+							     NULL);
+						goto err;
+					} else {
+						val = next;
+						arg_i++;
+						__WIMEY_STAT(ctx, tokens, 1);
+					}
+				}
+
+				if (!__wimey_take_argument(schema, sink, arg, val, argc, argv))
+					goto err;
+				if (val != NULL)
+					break;
+				arg = NULL;
+			}
+			continue;
+		}
+		}
+	}
+
+done:
+	/* Constraints of the registry, the batches skip them */
+	if (sink->batch == NULL && !schema->is_table && !__wimey_rules_check(ctx, level))
+		goto err;
+
+	return WIMEY_OK;
+
+err:
+	/* The failing token, the handlers don't know where they are */
+	if (ctx->error.index < 0)
+		ctx->error.index = arg_i < argc ? arg_i : -1;
+
+	ERR(ctx, "Error during parsing, invalid input");
+	return WIMEY_ERR;
+}
+
+/* --------------- Utility functions ---------------- */
+
+/* This function simply create a privilaged node
+ * that contains the help argument  */
+int wimey_ctx_generate_help(struct wimey_ctx *ctx) {
+	if(wimey_ctx_add_argument(ctx, help_arg) != WIMEY_OK) {
+		ERR(ctx, "Error during `--help` generation");
+		return WIMEY_ERR;
+	}
+	
+	return WIMEY_OK;
+}
+
+/* Growable text buffer for the help, allocated through the context */
+struct __wimey_text {
+	struct wimey_ctx *ctx;
+	char *data;
+	size_t len;
+	size_t cap;
+	bool failed;
+};
+
+/* Append formatted text, on allocation failure the buffer is
+ * marked as failed and the following appends do nothing */
+static void __wimey_text_printf(struct __wimey_text *text, const char *fmt, ...) {
+	va_list ap;
+	int n;
+
+	if (text->failed)
+		return;
+
+	va_start(ap, fmt);
+	n = vsnprintf(text->data + text->len, text->cap - text->len, fmt, ap);
+	va_end(ap);
+
+	if (n < 0) {
+		text->failed = true;
+		return;
+	}
+
+	if (text->len + n >= text->cap) {
+		size_t cap = text->cap * 2;
+
+		while (cap <= text->len + n)
+			cap *= 2;
+
+		char *data = __WIMEY_ALLOC(text->ctx, cap);
+
+		if (data == NULL) {
+			text->failed = true;
+			return;
+		}
+
+		memcpy(data, text->data, text->len);
+		__WIMEY_FREE(text->ctx, text->data);
+		text->data = data;
+		text->cap = cap;
+
+		va_start(ap, fmt);
+		vsnprintf(text->data + text->len, text->cap - text->len, fmt, ap);
+		va_end(ap);
+	}
+
+	text->len += n;
+}
+
+/* Render the help list and the program informations in `text`,
+ * `argv0` is the program name used when no usage is configured */
+static bool __wimey_render_help(const struct __wimey_schema *schema,
+				const char *argv0, struct __wimey_text *text) {
+	struct wimey_ctx *ctx = schema->ctx;
+
+	text->ctx = ctx;
+	text->len = 0;
+	text->failed = false;
+	text->cap = 1024;
+	text->data = __WIMEY_ALLOC(ctx, text->cap);
+	if (text->data == NULL)
+		return false;
+
+	if(ctx->conf.name[0] != '\0' && ctx->conf.version != NULL)
+		__wimey_text_printf(text, "%s (v%s)", ctx->conf.name, ctx->conf.version);
+	
+	if(ctx->conf.usage == NULL) {
+		__wimey_text_printf(text, "\n%s [options] [arguments]", argv0);
+	} else {
+		__wimey_text_printf(text, "\nUsage: %s\n", ctx->conf.usage);
+	}
+	
+	if(ctx->conf.description != NULL)
+		__wimey_text_printf(text, "\n%s\n", ctx->conf.description);
+	
+	/* We need to take the max command key len,
+	 * subcommands are shown with their parent path */
+	int max_cmd_len = 0;
+	for (size_t i = 0; i < schema->ncmds; i++) {
+		const struct wimey_command_t *cmd = __wimey_schema_command(schema, i);
+		int len = strlen(cmd->key);
+		if (cmd->parent != NULL) len += strlen(cmd->parent) + 1;
+		if (len > max_cmd_len) max_cmd_len = len;
+	}
+
+	int max_arg_len = 0;
+	for (size_t i = 0; i < schema->nargs; i++) {
+		const struct wimey_argument_t *arg = __wimey_schema_argument(schema, i);
+		int alen = strlen(arg->long_key) /* Adding len for --help  */
+			+ strlen(arg->short_key)  /* Adding len for -h */
+			+ 2; /* Adding len for the 2 spaces between --help and -h */
+		if(alen > max_arg_len) max_arg_len = alen;
+	}
+	
+	int max_len = max_cmd_len > max_arg_len ? max_cmd_len : max_arg_len;
+
+	__wimey_text_printf(text, "\n%s\n", "Commands:");
+	for (size_t i = 0; i < schema->ncmds; i++) {
+		const struct wimey_command_t *cmd = __wimey_schema_command(schema, i);
+		int pad = max_len - (int)strlen(cmd->key);
+
+		if (cmd->parent != NULL) {
+			pad -= strlen(cmd->parent) + 1;
+			__wimey_text_printf(text, "  %s ", cmd->parent);
+		} else {
+			__wimey_text_printf(text, "  ");
+		}
+
+		__wimey_text_printf(text, "%s%*s  %s\n", cmd->key, pad, "", cmd->desc);
+	}
+
+	__wimey_text_printf(text, "\n%s\n", "Arguments: ");
+	for (size_t i = 0; i < schema->nargs; i++) {
+		const struct wimey_argument_t *arg = __wimey_schema_argument(schema, i);
+		int pad = max_len - (int)(strlen(arg->short_key) + 2 + strlen(arg->long_key));
+
+		__wimey_text_printf(text, "  %s  %s%*s  %s\n", arg->short_key,
+				    arg->long_key, pad, "", arg->desc);
+	}
+	
+	if(ctx->conf.copyright != NULL)
+		__wimey_text_printf(text, "\n%s\n", ctx->conf.copyright);
+
+	if(ctx->conf.license != NULL)
+		__wimey_text_printf(text, "This software is under %s license.", ctx->conf.license);
+
+	if (text->failed) {
+		__WIMEY_FREE(ctx, text->data);
+		text->data = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+/* Help text for `schema`, the one of the sealed registry is
+ * rendered once and cached in the context. Returns NULL on
+ * allocation failure, `*owned` tells if the caller frees it. */
+static const char *__wimey_help_text(const struct __wimey_schema *schema,
+				     const char *argv0, size_t *len, bool *owned) {
+	struct wimey_ctx *ctx = schema->ctx;
+	bool cacheable = !schema->is_table && ctx->dict.sealed;
+	struct __wimey_text text;
+
+	/* argv[0] is only part of the text without a usage line */
+	if (cacheable && ctx->help.text != NULL
+	    && (ctx->conf.usage != NULL || ctx->help.argv0 == argv0)) {
+		*len = ctx->help.len;
+		*owned = false;
+		return ctx->help.text;
+	}
+
+	if (!__wimey_render_help(schema, argv0, &text))
+		return NULL;
+
+	*len = text.len;
+	*owned = !cacheable;
+	if (cacheable) {
+		__wimey_help_free(ctx);
+		ctx->help.text = text.data;
+		ctx->help.len = text.len;
+		ctx->help.argv0 = argv0;
+	}
+
+	return text.data;
+}
+
+/* Internal helper to print the help list and the program
+ * informations, the whole text goes out with a single write */
+void __wimey_print_help(const struct __wimey_schema *schema, int argc, char **argv) {
+	struct wimey_ctx *ctx = schema->ctx;
+	const char *help;
+	size_t len;
+	bool owned;
+	(void)argc;
+
+	help = __wimey_help_text(schema, argv[0], &len, &owned);
+	if (help == NULL) {
+		ERR(ctx, "Failed to render help");
+		return;
+	}
+
+	/* Anything printed before must come first */
+	fflush(stdout);
+
+	for (size_t done = 0; done < len; ) {
+		ssize_t n = write(STDOUT_FILENO, help + done, len - done);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		done += n;
+	}
+
+	if (owned)
+		__WIMEY_FREE(ctx, (void *)help);
+}
+
+/* Render the help into `buf`
+ * --------------------------
+ * Same text printed by --help, the program name comes from the
+ * configuration when there is no usage line. At most `len` bytes
+ * are written, always NUL terminated when len > 0.
+ * Returns: the full length of the help (like snprintf), 0 on error */
+size_t wimey_ctx_render_help(struct wimey_ctx *ctx, char *buf, size_t len) {
+	struct __wimey_schema schema = __wimey_registry_schema(ctx);
+	const char *argv0 = ctx->conf.name[0] != '\0' ? ctx->conf.name : "program";
+	const char *help;
+	size_t help_len;
+	bool owned;
+
+	help = __wimey_help_text(&schema, argv0, &help_len, &owned);
+	if (help == NULL) {
+		ERR(ctx, "Failed to render help");
+		return 0;
+	}
+
+	if (buf != NULL && len > 0) {
+		size_t n = help_len < len - 1 ? help_len : len - 1;
+
+		memcpy(buf, help, n);
+		buf[n] = '\0';
+	}
+
+	if (owned)
+		__WIMEY_FREE(ctx, (void *)help);
+	return help_len;
+}
+
+/* ------- Completion ------- */
+
+/* Completions come from every registered key kept in one sorted
+ * array: the keys starting with a prefix are a contiguous range
+ * found with two binary searches, no walk over the registry.
+ * The shell hooks run `prog --wimey-complete <words>`, the last
+ * word being the one under the cursor, answered by the program
+ * through wimey_complete_main(). */
+
+#define __WIMEY_COMPLETE_ARG "--wimey-complete"
+
+static int __wimey_key_cmp(const void *a, const void *b) {
+	return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+/* Build the sorted key array of a sealed registry */
+static bool __wimey_sort_keys(struct wimey_ctx *ctx) {
+	size_t n = 0;
+
+	if (ctx->dict.sorted_keys != NULL)
+		return true;
+
+	/* Room for at least one key, an empty array is "not built" */
+	ctx->dict.sorted_keys = __WIMEY_ALLOC(ctx, (ctx->dict.ncmds + ctx->dict.nargs * 2 + 1)
+					      * sizeof(const char *));
+	if (ctx->dict.sorted_keys == NULL) {
+		ERR(ctx, "Failed to allocate completion keys");
+		return false;
+	}
+
+	for (size_t i = 0; i < ctx->dict.ncmds; i++)
+		if (ctx->dict.cmds[i].cmd.key != NULL)
+			ctx->dict.sorted_keys[n++] = ctx->dict.cmds[i].cmd.key;
+
+	for (size_t i = 0; i < ctx->dict.nargs; i++) {
+		if (ctx->dict.args[i].argument.long_key != NULL)
+			ctx->dict.sorted_keys[n++] = ctx->dict.args[i].argument.long_key;
+		if (ctx->dict.args[i].argument.short_key != NULL)
+			ctx->dict.sorted_keys[n++] = ctx->dict.args[i].argument.short_key;
+	}
+
+	qsort(ctx->dict.sorted_keys, n, sizeof(const char *), __wimey_key_cmp);
+	ctx->dict.nsorted = n;
+	return true;
+}
+
+/* First key in [lo, hi) where `past` is false, over sorted keys */
+static size_t __wimey_key_search(const char **keys, size_t lo, size_t hi,
+				 const char *prefix, size_t len, bool past) {
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		int cmp = strncmp(keys[mid], prefix, len);
+
+		if (cmp < 0 || (past && cmp == 0))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* Walk the complete words (all but the last) the way the
+ * tokenizer does, `level` receives the command scope reached.
+ * Returns false when the partial word is a value or follows "--" */
+static bool __wimey_complete_level(struct wimey_ctx *ctx, int argc, char **argv,
+				   uint32_t *level) {
+	struct __wimey_schema schema = __wimey_registry_schema(ctx);
+
+	*level = 0;
+	for (int i = 0; i < argc - 1; i++) {
+		const void *entry;
+		char *inline_val;
+		bool takes_next = false;
+
+		switch (__wimey_classify_token(&schema, *level, argv[i], &entry, &inline_val)) {
+		case __WIMEY_TOK_END:
+			return false;
+
+		case __WIMEY_TOK_VALUE:
+			break;
+
+		case __WIMEY_TOK_COMMAND: {
+			const struct __wimey_command_node *node = entry;
+			const void *ahead;
+			char *ahead_val;
+
+			*level = node - ctx->dict.cmds + 1;
+			if (!node->cmd.has_value)
+				break;
+			if (i + 1 == argc - 1) {
+				/* An optional value may be a key as well */
+				if (node->cmd.is_value_required)
+					return false;
+				break;
+			}
+			if (__wimey_classify_token(&schema, *level, argv[i + 1], &ahead,
+						   &ahead_val) == __WIMEY_TOK_VALUE)
+				i++;
+			break;
+		}
+
+		case __WIMEY_TOK_LONG:
+		case __WIMEY_TOK_SHORT:
+			takes_next = inline_val == NULL && !__wimey_is_flag(entry);
+			break;
+
+		case __WIMEY_TOK_BUNDLE: {
+			const struct wimey_argument_t *arg = entry;
+
+			/* A key with a value ends the bundle */
+			for (const char *p = argv[i] + 1; *p != '\0'; p++) {
+				if (arg == NULL)
+					arg = __wimey_schema_find_short(&schema, *level, *p);
+				if (arg == NULL)
+					break;
+				if (!__wimey_is_flag(arg)) {
+					takes_next = p[1] == '\0';
+					break;
+				}
+				arg = NULL;
+			}
+			break;
+		}
+		}
+
+		if (takes_next) {
+			if (i + 1 == argc - 1)
+				return false;
+			i++;
+		}
+	}
+
+	return true;
+}
+
+/* Whether sorted key `i` is offered at `level`: the children of
+ * the command (its siblings for a leaf) and the arguments of the
+ * command and its parents, resolved as the tokenizer would. Equal
+ * keys of different scopes are adjacent, only the first is kept. */
+static bool __wimey_complete_offered(struct wimey_ctx *ctx, uint32_t level, size_t i) {
+	const char **keys = ctx->dict.sorted_keys;
+	char *key = (char *)keys[i];
+
+	if (i > 0 && strcmp(keys[i - 1], key) == 0)
+		return false;
+
+	if (key[0] == '-')
+		return __wimey_get_argument_node(ctx, level, key) != NULL;
+	return __wimey_get_command_node(ctx, level, key) != NULL;
+}
+
+/* Complete the last of `argc` words
+ * ---------------------------------
+ * `argv` are the words after the program name, the last one is
+ * the partial word. The keys matching it in the scope of the
+ * command the previous words entered go to `out` (at most `max`),
+ * nothing is offered after a key that takes a value, so the
+ * shell falls back to its own file completion.
+ * Returns: the number of matches, can be larger than `max` */
+size_t wimey_ctx_complete(struct wimey_ctx *ctx, int argc, char **argv,
+			  const char **out, size_t max) {
+	const char *partial = argc > 0 ? argv[argc - 1] : "";
+	size_t len = strlen(partial);
+	uint32_t level;
+	size_t n = 0;
+
+	if (wimey_ctx_finalize(ctx) != WIMEY_OK || !__wimey_sort_keys(ctx))
+		return 0;
+
+	if (!__wimey_complete_level(ctx, argc, argv, &level))
+		return 0;
+
+	const char **keys = ctx->dict.sorted_keys;
+	size_t first = __wimey_key_search(keys, 0, ctx->dict.nsorted, partial, len, false);
+	size_t last = __wimey_key_search(keys, first, ctx->dict.nsorted, partial, len, true);
+
+	for (size_t i = first; i < last; i++) {
+		if (!__wimey_complete_offered(ctx, level, i))
+			continue;
+		if (n < max)
+			out[n] = keys[i];
+		n++;
+	}
+
+	return n;
+}
+
+/* Answer a shell hook
+ * -------------------
+ * Programs that installed a hook with wimey_write_completion()
+ * call this first thing in main(), before printing anything. If
+ * argv is `prog --wimey-complete <words>` the completions are
+ * printed on stdout, one per line, and the program should exit.
+ * Returns: WIMEY_OK if argv was a completion request (answered),
+ * WIMEY_ERR otherwise, argv is then left to wimey_parse() */
+int wimey_ctx_complete_main(struct wimey_ctx *ctx, int argc, char **argv) {
+	struct __wimey_text text = { .ctx = ctx, .cap = 256 };
+
+	if (argc < 2 || strcmp(argv[1], __WIMEY_COMPLETE_ARG) != 0)
+		return WIMEY_ERR;
+
+	size_t n = wimey_ctx_complete(ctx, argc - 2, argv + 2, NULL, 0);
+	const char **out;
+
+	if (n == 0)
+		return WIMEY_OK;
+
+	out = __WIMEY_ALLOC(ctx, n * sizeof(const char *));
+	text.data = __WIMEY_ALLOC(ctx, text.cap);
+	if (out == NULL || text.data == NULL) {
+		ERR(ctx, "Failed to allocate completions");
+		if (out != NULL)
+			__WIMEY_FREE(ctx, out);
+		if (text.data != NULL)
+			__WIMEY_FREE(ctx, text.data);
+		return WIMEY_OK;
+	}
+
+	wimey_ctx_complete(ctx, argc - 2, argv + 2, out, n);
+	for (size_t i = 0; i < n; i++)
+		__wimey_text_printf(&text, "%s\n", out[i]);
+
+	if (!text.failed) {
+		fwrite(text.data, 1, text.len, stdout);
+		fflush(stdout);
+	}
+
+	__WIMEY_FREE(ctx, out);
+	__WIMEY_FREE(ctx, text.data);
+	return WIMEY_OK;
+}
+
+/* Write the completion hook of `prog` for bash, zsh or fish
+ * -------------------------------------------------------
+ * The hook is meant to be sourced by the shell, for example
+ * `source <(prog --completion bash)`.
+ * Returns: WIMEY_OK, WIMEY_ERR for an unknown shell */
+int wimey_write_completion(FILE *out, const char *shell, const char *prog) {
+	char fn[64];
+	size_t i;
+
+	if (out == NULL || shell == NULL || prog == NULL)
+		return WIMEY_ERR;
+
+	/* Shell function name from the program base name */
+	const char *base = strrchr(prog, '/');
+
+	base = base != NULL ? base + 1 : prog;
+	for (i = 0; base[i] != '\0' && i < sizeof(fn) - 1; i++) {
+		char c = base[i];
+
+		fn[i] = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+			|| (c >= '0' && c <= '9') ? c : '_';
+	}
+	fn[i] = '\0';
+
+	if (strcmp(shell, "bash") == 0) {
+		fprintf(out,
+			"_%s_wimey() {\n"
+			"\tlocal IFS=$'\\n'\n"
+			"\tCOMPREPLY=($(\"%s\" " __WIMEY_COMPLETE_ARG " \"${COMP_WORDS[@]:1:COMP_CWORD}\"))\n"
+			"}\n"
+			"complete -o default -F _%s_wimey %s\n",
+			fn, prog, fn, base);
+	} else if (strcmp(shell, "zsh") == 0) {
+		fprintf(out,
+			"#compdef %s\n"
+			"_%s_wimey() {\n"
+			"\tlocal -a keys\n"
+			"\tkeys=(\"${(@f)$(\"%s\" " __WIMEY_COMPLETE_ARG " \"${(@)words[2,CURRENT]}\")}\")\n"
+			"\tif (( ${#keys[@]} )) && [[ -n $keys[1] ]]; then\n"
+			"\t\tcompadd -a keys\n"
+			"\telse\n"
+			"\t\t_files\n"
+			"\tfi\n"
+			"}\n"
+			"compdef _%s_wimey %s\n",
+			base, fn, prog, fn, base);
+	} else if (strcmp(shell, "fish") == 0) {
+		fprintf(out,
+			"function __%s_wimey\n"
+			"\tset -l words (commandline -opc)\n"
+			"\tset -e words[1]\n"
+			"\t\"%s\" " __WIMEY_COMPLETE_ARG " $words (commandline -ct)\n"
+			"end\n"
+			"complete -c %s -a '(__%s_wimey)'\n",
+			fn, prog, base, fn);
+	} else {
+		ERR(&wimey_default_ctx, "Unknown shell %s", shell);
+		return WIMEY_ERR;
+	}
+
+	return WIMEY_OK;
+}
+
+/* ------- Value converters ------- */
+
+/* The converters below don't use strtol()/strtod(): they are
+ * locale independent and report errors apart from the value.
+ * Integers are read 8 digits at a time (SWAR), decimals take
+ * an exact fast path when the mantissa and the power of ten are
+ * both exactly representable as double, strtod_l() in the "C"
+ * locale is the fallback for everything else (long mantissas,
+ * huge exponents, inf, nan) */
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define __WIMEY_SWAR 1
+#endif
+
+/* Returns true if the 8 bytes of `chunk` are all ASCII digits */
+static bool __wimey_is_8_digits(uint64_t chunk) {
+	return (((chunk & 0xF0F0F0F0F0F0F0F0ull)
+		 | (((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4))
+		== 0x3333333333333333ull);
+}
+
+/* Convert 8 ASCII digits (little endian load) to their value */
+static uint32_t __wimey_parse_8_digits(uint64_t chunk) {
+	chunk = (chunk & 0x0F0F0F0F0F0F0F0Full) * 2561 >> 8;
+	chunk = (chunk & 0x00FF00FF00FF00FFull) * 6553601 >> 16;
+	return (uint32_t)((chunk & 0x0000FFFF0000FFFFull) * 42949672960001ull >> 32);
+}
+
+/* Read the decimal digits at `*p` into `*res`, stops at the first
+ * non digit. Returns the number of digits read, or -1 if the value
+ * doesn't fit in 64 bits. */
+static int __wimey_read_digits(const char **p, const char *end, uint64_t *res) {
+	const char *s = *p;
+	uint64_t v = 0;
+	int n = 0;
+
+#ifdef __WIMEY_SWAR
+	/* 8 digits per step while they can't overflow (8 + 8 < 20) */
+	while (end - s >= 8 && n <= 8) {
+		uint64_t chunk;
+
+		memcpy(&chunk, s, sizeof(chunk));
+		if (!__wimey_is_8_digits(chunk))
+			break;
+
+		v = v * 100000000u + __wimey_parse_8_digits(chunk);
+		s += 8;
+		n += 8;
+	}
+#endif
+
+	while (s < end && *s >= '0' && *s <= '9') {
+		unsigned d = *s - '0';
+
+		if (v > (UINT64_MAX - d) / 10)
+			return -1;
+
+		v = v * 10 + d;
+		s++;
+		n++;
+	}
+
+	*p = s;
+	*res = v;
+	return n;
+}
+
+/* Parse an optionally signed decimal integer, the whole string
+ * must be consumed. `mag` receives the magnitude. */
+static bool __wimey_parse_integer(const char *val, uint64_t *mag, bool *neg) {
+	if (val == NULL)
+		return false;
+
+	const char *end = val + strlen(val);
+	const char *p = val;
+
+	while (p < end && (*p == ' ' || *p == '\t'))
+		p++;
+
+	*neg = false;
+	if (p < end && (*p == '+' || *p == '-'))
+		*neg = *p++ == '-';
+
+	if (__wimey_read_digits(&p, end, mag) <= 0)
+		return false;
+
+	return p == end;
+}
+
+/* Convert a string to long
+ * ------------------------
+ * Arguments:
+ *  const char *val - decimal string
+ *  long *out - destination, untouched on failure
+ * Returns: WIMEY_OK or WIMEY_ERR if not a number or out of range */
+int wimey_val_parse_long(const char *val, long *out) {
+	uint64_t mag;
+	bool neg;
+
+	if (!__wimey_parse_integer(val, &mag, &neg))
+		return WIMEY_ERR;
+
+	if (neg) {
+		if (mag > (uint64_t)LONG_MAX + 1)
+			return WIMEY_ERR;
+		*out = mag == (uint64_t)LONG_MAX + 1 ? LONG_MIN : -(long)mag;
+		return WIMEY_OK;
+	}
+
+	if (mag > LONG_MAX)
+		return WIMEY_ERR;
+
+	*out = (long)mag;
+	return WIMEY_OK;
+}
+
+/* Convert a string to uint64_t, negative values are an error */
+int wimey_val_parse_u64(const char *val, uint64_t *out) {
+	uint64_t mag;
+	bool neg;
+
+	if (!__wimey_parse_integer(val, &mag, &neg) || (neg && mag != 0))
+		return WIMEY_ERR;
+
+	*out = mag;
+	return WIMEY_OK;
+}
+
+/* Exact powers of ten as double */
+static const double __wimey_pow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+	1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+	1e21, 1e22
+};
+
+/* Exact fast path (Clinger): [+-]digits[.digits][e[+-]digits]
+ * with a mantissa < 2^53 and a power of ten <= 10^22, both are
+ * exact doubles so one multiplication or division rounds right.
+ * Returns false if the input needs the slow path. */
+static bool __wimey_fast_double(const char *val, const char *end, double *out) {
+	const char *p = val;
+	uint64_t mant = 0, frac = 0, exp = 0;
+	bool neg = false, exp_neg = false;
+
+	if (p < end && (*p == '+' || *p == '-'))
+		neg = *p++ == '-';
+
+	const char *start = p;
+	int int_digits = __wimey_read_digits(&p, end, &mant);
+	int frac_digits = 0;
+
+	if (int_digits < 0 || int_digits > 19)
+		return false;
+
+	if (p < end && *p == '.') {
+		p++;
+		frac_digits = __wimey_read_digits(&p, end, &frac);
+		if (frac_digits < 0 || int_digits + frac_digits > 19)
+			return false;
+
+		/* mant.frac -> one integer mantissa */
+		mant = mant * (uint64_t)__wimey_pow10[frac_digits] + frac;
+	}
+
+	if (p == start || (int_digits == 0 && frac_digits == 0))
+		return false;
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		p++;
+		if (p < end && (*p == '+' || *p == '-'))
+			exp_neg = *p++ == '-';
+
+		int exp_digits = __wimey_read_digits(&p, end, &exp);
+		if (exp_digits <= 0 || exp_digits > 4)
+			return false;
+	}
+
+	if (p != end || mant > (1ull << 53))
+		return false;
+
+	long e10 = (exp_neg ? -(long)exp : (long)exp) - frac_digits;
+	double res = (double)mant;
+
+	if (e10 < -22 || e10 > 22)
+		return false;
+
+	res = e10 < 0 ? res / __wimey_pow10[-e10] : res * __wimey_pow10[e10];
+	*out = neg ? -res : res;
+	return true;
+}
+
+/* "C" numeric locale of the strtod_l() fallback, created once
+ * for the process and never freed */
+static pthread_once_t __wimey_c_locale_once = PTHREAD_ONCE_INIT;
+static locale_t __wimey_c_locale;
+
+static void __wimey_c_locale_init(void) {
+	__wimey_c_locale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+}
+
+/* Convert a string to double
+ * --------------------------
+ * Arguments:
+ *  const char *val - decimal string
+ *  double *out - destination, untouched on failure
+ * Returns: WIMEY_OK or WIMEY_ERR if `val` isn't entirely a number */
+int wimey_val_parse_double(const char *val, double *out) {
+	double res;
+	char *p_end;
+
+	if (val == NULL || *val == '\0')
+		return WIMEY_ERR;
+
+	if (__wimey_fast_double(val, val + strlen(val), out))
+		return WIMEY_OK;
+
+	pthread_once(&__wimey_c_locale_once, __wimey_c_locale_init);
+	if (__wimey_c_locale == (locale_t)0)
+		return WIMEY_ERR;
+
+	errno = 0;
+	res = strtod_l(val, &p_end, __wimey_c_locale);
+
+	/* Underflow is a valid (subnormal or zero) value */
+	if (p_end == val || *p_end != '\0'
+	    || (errno == ERANGE && (res == HUGE_VAL || res == -HUGE_VAL)))
+		return WIMEY_ERR;
+
+	*out = res;
+	return WIMEY_OK;
+}
+
+/* Convert a string to float, out of range values are an error */
+int wimey_val_parse_float(const char *val, float *out) {
+	double res;
+
+	if (wimey_val_parse_double(val, &res) != WIMEY_OK)
+		return WIMEY_ERR;
+
+	if (res > FLT_MAX || res < -FLT_MAX)
+		return WIMEY_ERR;
+
+	*out = (float)res;
+	return WIMEY_OK;
+}
+
+/* Generic string to long converter that can be used
+ * for different integer subtypes (uint16_t, int32_t etc),
+ * returns WIMEY_ERR (0) on failure: use wimey_val_parse_long()
+ * to tell it apart from a real 0 */
+long wimey_val_to_long(const char *val) {
+	long res;
+
+	if (wimey_val_parse_long(val, &res) != WIMEY_OK)
+		goto err;
+
+	return res;
+
+err:
+	ERR(&wimey_default_ctx, "Conversion failed, check input: %s", val);
+	return WIMEY_ERR;
+}
+
+/* Convert command/argument value to int */
+int wimey_val_to_int(const char *val) {
+	return (int)wimey_val_to_long(val);
+}
+
+/* Convert command/argument value to float */
+float wimey_val_to_float(const char *val) {
+	float res;
+
+	if (wimey_val_parse_float(val, &res) != WIMEY_OK)
+		goto err;
+
+	return res;
+
+err:
+	ERR(&wimey_default_ctx, "Conversion failed, check input: %s", val);
+	return WIMEY_ERR;
+}
+
+/* Convert command/argument value to double */
+double wimey_val_to_double(const char *val) {
+	double res;
+
+	if (wimey_val_parse_double(val, &res) != WIMEY_OK)
+		goto err;
+
+	return res;
+
+err:
+	ERR(&wimey_default_ctx, "Conversion failed, check input: %s", val);
+	return WIMEY_ERR;
+}
+
+/* Convert string to unsigned long long */
+uint64_t wimey_val_to_u64(const char *val) {
+	uint64_t res;
+
+	if (wimey_val_parse_u64(val, &res) != WIMEY_OK)
+		goto err;
+
+	return res;
+
+err:
+	ERR(&wimey_default_ctx, "Conversion failed, check input: %s", val);
+	return WIMEY_ERR;
+}
+
+/* Basic cast of wimey_val_to_long to return char */
+char wimey_val_to_char(const char *val) {
+	return (char)wimey_val_to_long(val);
+}
+
+/* ------- Response files ------- */
+
+/* An `@path` token stands for the tokens stored in the file at
+ * `path`. The file is mapped private and writable, tokens are
+ * unquoted in place and NUL terminated where they end, so the
+ * expanded argv points straight into the mapping: the only
+ * allocations are the (geometrically grown) pointer arrays.
+ * Inside a file tokens are separated by whitespace, '...' is
+ * literal, "..." allows \" and \\, a backslash outside quotes
+ * escapes the next character. Files are not expanded recursively. */
+
+/* Unmap the files of the previous parse */
+static void __wimey_argfiles_release(struct wimey_ctx *ctx) {
+	for (size_t i = 0; i < ctx->argfiles.nmaps; i++)
+		munmap(ctx->argfiles.maps[i].addr, ctx->argfiles.maps[i].len);
+
+	ctx->argfiles.nmaps = 0;
+	ctx->argfiles.nargv = 0;
+}
+
+/* Append a token to the expanded argv */
+static bool __wimey_argfiles_push(struct wimey_ctx *ctx, char *tok) {
+	if (ctx->argfiles.nargv == ctx->argfiles.argv_cap) {
+		size_t cap = ctx->argfiles.argv_cap ? ctx->argfiles.argv_cap * 2 : 64;
+
+		if (!__wimey_resize(ctx, (void **)&ctx->argfiles.argv,
+				    ctx->argfiles.nargv, cap, sizeof(char *)))
+			return false;
+		ctx->argfiles.argv_cap = cap;
+	}
+
+	ctx->argfiles.argv[ctx->argfiles.nargv++] = tok;
+	return true;
+}
+
+/* Append a slot to a mapping array */
+static struct __wimey_mapping *__wimey_mapping_slot(struct wimey_ctx *ctx,
+						    struct __wimey_mapping **maps,
+						    size_t count, size_t *cap) {
+	if (count == *cap) {
+		size_t new_cap = *cap ? *cap * 2 : 4;
+
+		if (!__wimey_resize(ctx, (void **)maps, count, new_cap,
+				    sizeof(struct __wimey_mapping)))
+			return NULL;
+		*cap = new_cap;
+	}
+
+	return &(*maps)[count];
+}
+
+/* Map `path` private and writable with one spare zero byte after
+ * its end, so the last token can be terminated in place even if
+ * the file fills its last page. Returns the file size or -1. */
+static long __wimey_file_map(const char *path, struct __wimey_mapping *map) {
+	struct stat st;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) != 0 || st.st_size < 0 || st.st_size >= LONG_MAX)
+		goto err;
+
+	/* Anonymous reservation first, the file is mapped over it */
+	map->len = st.st_size + 1;
+	map->addr = mmap(NULL, map->len, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (map->addr == MAP_FAILED)
+		goto err;
+
+	if (st.st_size > 0) {
+		if (mmap(map->addr, st.st_size, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+			munmap(map->addr, map->len);
+			goto err;
+		}
+		madvise(map->addr, st.st_size, MADV_SEQUENTIAL);
+	}
+
+	close(fd);
+	return st.st_size;
+
+err:
+	close(fd);
+	return -1;
+}
+
+/* Map a response file, kept until the next parse */
+static long __wimey_argfile_map(struct wimey_ctx *ctx, const char *path, char **addr) {
+	struct __wimey_mapping *map;
+	long size;
+
+	map = __wimey_mapping_slot(ctx, &ctx->argfiles.maps, ctx->argfiles.nmaps,
+				   &ctx->argfiles.maps_cap);
+	if (map == NULL) {
+		__wimey_fail(ctx, WIMEY_E_NO_MEMORY, NULL, NULL);
+		return -1;
+	}
+
+	size = __wimey_file_map(path, map);
+	if (size < 0) {
+		ERR(ctx, "Failed to read response file %s", path);
+		__wimey_fail(ctx, WIMEY_E_FILE, NULL, path);
+		return -1;
+	}
+
+	ctx->argfiles.nmaps++;
+	*addr = map->addr;
+	return size;
+}
+
+static bool __wimey_is_space(char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r'
+	    || c == '\v' || c == '\f';
+}
+
+/* Split the mapped file [p, end) in tokens, one pass: quotes and
+ * escapes are removed while the token is scanned */
+static bool __wimey_argfile_split(struct wimey_ctx *ctx, const char *path,
+				  char *p, char *end) {
+	while (true) {
+		while (p < end && __wimey_is_space(*p))
+			p++;
+		if (p >= end)
+			return true;
+
+		char *tok = p, *w = p;
+		char quote = '\0';
+
+		while (p < end) {
+			char c = *p;
+
+			if (quote == '\0') {
+				if (__wimey_is_space(c))
+					break;
+
+				if (c == '\'' || c == '"') {
+					quote = c;
+					p++;
+				} else if (c == '\\' && p + 1 < end) {
+					*w++ = p[1];
+					p += 2;
+				} else {
+					*w++ = c;
+					p++;
+				}
+			} else if (c == quote) {
+				quote = '\0';
+				p++;
+			} else if (quote == '"' && c == '\\' && p + 1 < end
+				   && (p[1] == '"' || p[1] == '\\')) {
+				*w++ = p[1];
+				p += 2;
+			} else {
+				*w++ = c;
+				p++;
+			}
+		}
+
+		if (quote != '\0') {
+			ERR(ctx, "Unterminated quote in response file %s", path);
+			__wimey_fail(ctx, WIMEY_E_FILE, NULL, path);
+			return false;
+		}
+
+		/* `w` never passes `p`, `end` itself is the spare byte */
+		*w = '\0';
+		p++;
+
+		if (!__wimey_argfiles_push(ctx, tok))
+			return false;
+	}
+}
+
+/* Replace `*argv` with its expansion if it contains @file tokens,
+ * the result is valid until the next parse or wimey_free_all() */
+static bool __wimey_argfiles_expand(struct wimey_ctx *ctx, int *argc, char ***argv) {
+	int i;
+
+	__wimey_argfiles_release(ctx);
+
+	for (i = 1; i < *argc; i++) {
+		if (strcmp((*argv)[i], "--") == 0)
+			return true;
+		if ((*argv)[i][0] == '@' && (*argv)[i][1] != '\0')
+			break;
+	}
+
+	if (i >= *argc)
+		return true;
+
+	bool end_of_options = false;
+
+	for (i = 0; i < *argc; i++) {
+		char *tok = (*argv)[i];
+
+		if (i == 0 || end_of_options || tok[0] != '@' || tok[1] == '\0') {
+			end_of_options = end_of_options || (i > 0 && strcmp(tok, "--") == 0);
+			if (!__wimey_argfiles_push(ctx, tok))
+				goto err;
+			continue;
+		}
+
+		char *addr;
+		long size = __wimey_argfile_map(ctx, tok + 1, &addr);
+
+		if (size < 0 || !__wimey_argfile_split(ctx, tok + 1, addr, addr + size))
+			goto err;
+	}
+
+	if (ctx->argfiles.nargv > INT_MAX) {
+		ERR(ctx, "Too many arguments in response files");
+		__wimey_fail(ctx, WIMEY_E_FILE, NULL, NULL);
+		goto err;
+	}
+
+	*argc = ctx->argfiles.nargv;
+	if (!__wimey_argfiles_push(ctx, NULL))
+		goto err;
+
+	*argv = ctx->argfiles.argv;
+	return true;
+
+err:
+	__wimey_argfiles_release(ctx);
+	return false;
+}
+
+/* ------- Configuration files ------- */
+
+/* One entry per line, "key=value" or "key value", where key is the
+ * long key without the leading "--" (a key starting with '-' is
+ * taken as is). Blank lines and lines starting with '#' or ';' are
+ * skipped, a value may be enclosed in double quotes. Flags take no
+ * value or one of 1/0, true/false, yes/no, on/off.
+ * A "[remote add]" line starts the section of a command path, its
+ * keys are looked up like argv does after that command: its own
+ * arguments then its parents' ones. "[]" goes back to the global
+ * arguments, where the file starts.
+ * Like response files the file is mapped private and writable, keys
+ * and values are terminated in place and the mapping is kept until
+ * wimey_free_all(), so strings not duplicated can point into it. */
+
+/* Matches the long key "--" + `key` */
+static const char *__wimey_config_key_of(void *node, const char *key) {
+	struct __wimey_argument_node *arg = node;
+	const char *long_key = arg->argument.long_key;
+
+	if (long_key != NULL && long_key[0] == '-' && long_key[1] == '-'
+	    && strcmp(long_key + 2, key) == 0)
+		return long_key;
+
+	return NULL;
+}
+
+/* Argument of a configuration key in the section `level`, the
+ * hash of "--" + key is computed without building the string */
+static struct __wimey_argument_node *__wimey_config_argument(struct wimey_ctx *ctx,
+							      uint32_t level, char *key) {
+	if (key[0] == '-')
+		return __wimey_get_argument_node(ctx, level, key);
+
+	uint32_t hash = __wimey_hash_from(__wimey_hash("--"), key);
+
+	/* Innermost command first, like __wimey_get_argument_node() */
+	for (;;) {
+		if (ctx->dict.sealed) {
+			struct __wimey_argument_node *node =
+			    __wimey_index_probe(ctx, ctx->dict.arg_slots, ctx->dict.arg_mask,
+						level, hash, key, __wimey_config_key_of);
+			if (node != NULL)
+				return node;
+		} else {
+			for (size_t i = 0; i < ctx->dict.nargs; i++) {
+				if (ctx->dict.args[i].level != level)
+					continue;
+
+				__WIMEY_STAT(ctx, key_compares, 1);
+				if (__wimey_config_key_of(&ctx->dict.args[i], key) != NULL)
+					return &ctx->dict.args[i];
+			}
+		}
+
+		if (level == 0)
+			return NULL;
+		level = __wimey_parent_level(ctx, level);
+	}
+}
+
+/* Value of a flag, -1 if it isn't a boolean */
+static int __wimey_config_bool(const char *val) {
+	static const char *yes[] = { "", "1", "true", "yes", "on" };
+	static const char *no[] = { "0", "false", "no", "off" };
+
+	for (size_t i = 0; i < sizeof(yes) / sizeof(yes[0]); i++)
+		if (strcmp(val, yes[i]) == 0)
+			return true;
+
+	for (size_t i = 0; i < sizeof(no) / sizeof(no[0]); i++)
+		if (strcmp(val, no[i]) == 0)
+			return false;
+
+	return -1;
+}
+
+static bool __wimey_is_blank(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+/* Lazy slot of argument `i` among the config file values, they
+ * last like the mapping they point into. NULL on failure */
+static struct __wimey_lazy_slot *__wimey_config_lazy_slot(struct wimey_ctx *ctx, size_t i) {
+	if (i >= ctx->lazy.preset_cap) {
+		size_t cap = ctx->dict.nargs;
+		struct __wimey_lazy_slot *preset = __WIMEY_ALLOC(ctx, cap * sizeof(*preset));
+
+		if (preset == NULL) {
+			ERR(ctx, "Failed to allocate lazy values");
+			__wimey_fail(ctx, WIMEY_E_NO_MEMORY, NULL, NULL);
+			return NULL;
+		}
+
+		memset(preset, 0, cap * sizeof(*preset));
+		if (ctx->lazy.preset != NULL) {
+			memcpy(preset, ctx->lazy.preset, ctx->lazy.preset_cap * sizeof(*preset));
+			__WIMEY_FREE(ctx, ctx->lazy.preset);
+		}
+		ctx->lazy.preset = preset;
+		ctx->lazy.preset_cap = cap;
+	}
+
+	return &ctx->lazy.preset[i];
+}
+
+/* Store one configuration entry */
+static bool __wimey_config_apply(struct wimey_ctx *ctx, const char *path, size_t line,
+				 uint32_t level, char *key, char *val) {
+	struct __wimey_argument_node *node = __wimey_config_argument(ctx, level, key);
+
+	if (node == NULL) {
+		struct __wimey_schema schema = __wimey_registry_schema(ctx);
+		char tok[__WIMEY_SUGGEST_MAX + 1];
+		const char *hint = NULL;
+
+		/* Suggest among the long keys, shown without "--" */
+		if (ctx->conf.log_level >= LOG_ERR_AND_WARNS
+		    && strlen(key) + 2 <= __WIMEY_SUGGEST_MAX) {
+			snprintf(tok, sizeof(tok), "--%s", key);
+			hint = __wimey_suggest(&schema, false, tok, strlen(tok));
+		}
+
+		if (hint != NULL && hint[1] == '-')
+			WARN(ctx, "%s:%zu: unknown key `%s`, did you mean `%s`?",
+			     path, line, key, hint + 2);
+		else
+			WARN(ctx, "%s:%zu: unknown key `%s`", path, line, key);
+		return true;
+	}
+
+	const struct wimey_argument_t *arg = &node->argument;
+	struct __wimey_lazy_slot *slot = NULL;
+
+	if (!__wimey_rules_preset(ctx, node - ctx->dict.args))
+		return false;
+
+	if (__wimey_lazy_keeps(ctx, arg)) {
+		slot = __wimey_config_lazy_slot(ctx, node - ctx->dict.args);
+		if (slot == NULL)
+			return false;
+	}
+
+	if (__wimey_is_flag(arg)) {
+		int b = __wimey_config_bool(val);
+
+		if (b < 0) {
+			ERR(ctx, "%s:%zu: invalid value `%s` for %s", path, line, val, arg->long_key);
+			__wimey_fail(ctx, WIMEY_E_INVALID_VALUE, arg->long_key, val);
+			return false;
+		}
+
+		if (slot != NULL)
+			__wimey_lazy_keep(slot, b, NULL);
+		else if (arg->value_dest != NULL)
+			*(int *)arg->value_dest = b;
+		return true;
+	}
+
+	if (val[0] == '\0') {
+		ERR(ctx, "%s:%zu: %s requires value `%s` but none provided",
+		    path, line, arg->long_key, arg->value_name);
+		__wimey_fail(ctx, WIMEY_E_MISSING_VALUE, arg->long_key, NULL);
+		return false;
+	}
+
+	/* Converted when read, like argv values */
+	if (slot != NULL) {
+		__wimey_lazy_keep(slot, 1, val);
+		return true;
+	}
+
+	/* The mapping outlives the parses, only duplicated
+	 * strings need to be stored */
+	if (arg->value_type == WIMEY_STR && ctx->conf.str_mode != WIMEY_STR_DUP) {
+		if (arg->value_dest != NULL)
+			*(char **)arg->value_dest = val;
+		return true;
+	}
+
+	if (arg->value_type == WIMEY_STR_LIST && ctx->conf.str_mode != WIMEY_STR_DUP) {
+		if (arg->value_dest != NULL && !__wimey_list_push(ctx, arg, val, true))
+			return false;
+		return true;
+	}
+
+	if (!__wimey_process_argument(ctx, arg, val)) {
+		ERR(ctx, "%s:%zu: invalid entry for %s", path, line, arg->long_key);
+		return false;
+	}
+
+	return true;
+}
+
+/* Unmap the configuration files from the `from`-th on */
+static void __wimey_configs_unmap(struct wimey_ctx *ctx, size_t from) {
+	for (size_t i = from; i < ctx->configs.nmaps; i++)
+		munmap(ctx->configs.maps[i].addr, ctx->configs.maps[i].len);
+
+	ctx->configs.nmaps = from;
+	ctx->configs.last_unused = false;
+}
+
+/* Load a configuration file
+ * -------------------------
+ * Fills the value_dest of the registered arguments from `path`
+ * in a single pass, call it before wimey_ctx_parse() so the
+ * command line overrides the file. Unknown keys are warnings.
+ * With WIMEY_STR_DUP (and not lazy) no value points into the
+ * file, it's released by the next load: reloading keeps a single
+ * mapping. Otherwise files stay mapped until
+ * wimey_ctx_release_config_files() or wimey_ctx_free_all().
+ * Returns: WIMEY_OK, WIMEY_ERR on the first invalid entry */
+int wimey_ctx_load_config_file(struct wimey_ctx *ctx, const char *path) {
+	struct __wimey_mapping *map;
+	uint32_t level = 0;
+	bool skip = false;	/* in the section of an unknown command */
+	long size;
+
+	/* The file is a new source for the lists */
+	ctx->lists.gen++;
+	__wimey_error_reset(ctx);
+
+	/* Only the error record could still point into it */
+	if (ctx->configs.last_unused)
+		__wimey_configs_unmap(ctx, ctx->configs.nmaps - 1);
+
+	map = __wimey_mapping_slot(ctx, &ctx->configs.maps, ctx->configs.nmaps,
+				   &ctx->configs.maps_cap);
+	if (map == NULL) {
+		__wimey_fail(ctx, WIMEY_E_NO_MEMORY, NULL, NULL);
+		goto err;
+	}
+
+	size = __wimey_file_map(path, map);
+	if (size < 0) {
+		ERR(ctx, "Failed to read configuration file %s", path);
+		__wimey_fail(ctx, WIMEY_E_FILE, NULL, path);
+		goto err;
+	}
+	ctx->configs.nmaps++;
+	ctx->configs.last_unused = ctx->conf.str_mode == WIMEY_STR_DUP && !ctx->conf.lazy;
+
+	char *p = map->addr, *end = map->addr + size;
+
+	for (size_t line = 1; p < end; line++) {
+		char *eol = memchr(p, '\n', end - p);
+
+		if (eol == NULL)
+			eol = end;	/* the spare byte */
+
+		while (p < eol && (__wimey_is_blank(*p) || *p == '\v' || *p == '\f'))
+			p++;
+
+		if (p == eol || *p == '#' || *p == ';') {
+			p = eol + 1;
+			continue;
+		}
+
+		if (*p == '[') {
+			char *name = p + 1, *name_end = memchr(name, ']', eol - name);
+
+			if (name_end == NULL) {
+				ERR(ctx, "%s:%zu: unterminated section", path, line);
+				__wimey_fail(ctx, WIMEY_E_FILE, NULL, path);
+				ctx->error.index = line;
+				goto err;
+			}
+
+			while (name < name_end && __wimey_is_blank(*name))
+				name++;
+			while (name_end > name && __wimey_is_blank(name_end[-1]))
+				name_end--;
+			*name_end = '\0';
+
+			skip = !__wimey_resolve_path(ctx, name, &level);
+			if (skip)
+				WARN(ctx, "%s:%zu: unknown command `%s`, section skipped",
+				     path, line, name);
+
+			p = eol + 1;
+			continue;
+		}
+
+		if (skip) {
+			p = eol + 1;
+			continue;
+		}
+
+		char *key = p;
+
+		while (p < eol && !__wimey_is_blank(*p) && *p != '=')
+			p++;
+
+		char *key_end = p;
+
+		while (p < eol && __wimey_is_blank(*p))
+			p++;
+		if (p < eol && *p == '=')
+			p++;
+		while (p < eol && __wimey_is_blank(*p))
+			p++;
+
+		char *val = p, *val_end = eol;
+
+		while (val_end > val && __wimey_is_blank(val_end[-1]))
+			val_end--;
+
+		if (val_end - val >= 2 && val[0] == '"' && val_end[-1] == '"') {
+			val++;
+			val_end--;
+		}
+
+		*key_end = '\0';
+		*val_end = '\0';
+
+		if (!__wimey_config_apply(ctx, path, line, level, key, val)) {
+			ctx->error.index = line;
+			goto err;
+		}
+
+		p = eol + 1;
+	}
+
+	return WIMEY_OK;
+
+err:
+	ERR(ctx, "Error during configuration loading");
+	return WIMEY_ERR;
+}
+
+/* Release the configuration files
+ * --------------------------------
+ * Unmaps every loaded file and forgets what they set for the
+ * lazy values and the constraints. Strings borrowed from them
+ * (WIMEY_STR_BORROW, WIMEY_STR_BUFFER, lists) dangle until the
+ * arguments are set again: a daemon reloading its configuration
+ * calls it right before wimey_ctx_load_config_file(). */
+void wimey_ctx_release_config_files(struct wimey_ctx *ctx) {
+	__wimey_configs_unmap(ctx, 0);
+
+	if (ctx->lazy.preset != NULL)
+		memset(ctx->lazy.preset, 0, ctx->lazy.preset_cap * sizeof(*ctx->lazy.preset));
+	if (ctx->rules.preset != NULL)
+		memset(ctx->rules.preset, 0, ctx->rules.preset_words * sizeof(uint64_t));
+}
+
+/* ------- Environment ------- */
+
+/* Store the value of an environment variable bound to `arg`,
+ * flags accept the same values of configuration files */
+static bool __wimey_env_apply(struct wimey_ctx *ctx, const struct wimey_argument_t *arg,
+			      const char *name, char *val) {
+	/* `argument` is the first member of the node */
+	size_t i = (const struct __wimey_argument_node *)arg - ctx->dict.args;
+	struct __wimey_lazy_slot *slot = __wimey_lazy_keeps(ctx, arg) ? &ctx->lazy.slots[i] : NULL;
+
+	__wimey_rules_mark(ctx, i);
+
+	if (__wimey_is_flag(arg)) {
+		int b = __wimey_config_bool(val);
+
+		if (b < 0) {
+			ERR(ctx, "Invalid value `%s` for %s in %s", val, arg->long_key, name);
+			__wimey_fail(ctx, WIMEY_E_INVALID_VALUE, arg->long_key, val);
+			return false;
+		}
+
+		if (slot != NULL)
+			__wimey_lazy_keep(slot, b ? ctx->lazy.gen : 0, NULL);
+		else if (arg->value_dest != NULL)
+			*(int *)arg->value_dest = b;
+		return true;
+	}
+
+	/* The environment outlives the parse, nothing to copy */
+	if (slot != NULL) {
+		__wimey_lazy_keep(slot, ctx->lazy.gen, val);
+		return true;
+	}
+
+	if (!__wimey_process_argument(ctx, arg, val)) {
+		ERR(ctx, "Invalid environment variable %s", name);
+		return false;
+	}
+
+	return true;
+}
+
+/* Apply the variables bound with env_key, before argv so the
+ * command line wins. A sealed registry scans environ once and
+ * resolves each name with one probe in the env index, otherwise
+ * the (few) bound arguments are looked up with getenv(). In lazy
+ * mode the values go to the slots, after __wimey_lazy_begin(). */
+static bool __wimey_apply_env(struct wimey_ctx *ctx) {
+	ctx->lists.gen++;
+
+	if (!ctx->dict.sealed) {
+		for (size_t i = 0; i < ctx->dict.nargs; i++) {
+			const struct wimey_argument_t *arg = &ctx->dict.args[i].argument;
+			char *val;
+
+			if (arg->env_key == NULL || (val = getenv(arg->env_key)) == NULL)
+				continue;
+			if (!__wimey_env_apply(ctx, arg, arg->env_key, val))
+				return false;
+		}
+		return true;
+	}
+
+	if (ctx->dict.nenv == 0 || environ == NULL)
+		return true;
+
+	for (char **env = environ; *env != NULL; env++) {
+		struct __wimey_argument_node *node;
+		char *eq = strchr(*env, '=');
+
+		if (eq == NULL)
+			continue;
+
+		node = __wimey_index_probe(ctx, ctx->dict.env_slots, ctx->dict.env_mask, 0,
+					   __wimey_hash_until(*env, '='), *env,
+					   __wimey_env_key_of);
+		if (node != NULL
+		    && !__wimey_env_apply(ctx, &node->argument, node->argument.env_key, eq + 1))
+			return false;
+	}
+
+	return true;
+}
+
+/* ------- Lazy values ------- */
+
+/* Prepare the slots for a lazy parse: one per
+ * registered argument, slots of earlier parses are made
+ * stale by bumping the generation instead of clearing them */
+static bool __wimey_lazy_begin(struct wimey_ctx *ctx) {
+	if (ctx->lazy.cap < ctx->dict.nargs) {
+		size_t size = ctx->dict.nargs * sizeof(struct __wimey_lazy_slot);
+		struct __wimey_lazy_slot *slots = __WIMEY_ALLOC(ctx, size);
+
+		if (slots == NULL) {
+			ERR(ctx, "Failed to allocate lazy values");
+			__wimey_fail(ctx, WIMEY_E_NO_MEMORY, NULL, NULL);
+			return false;
+		}
+
+		if (ctx->lazy.slots != NULL)
+			__WIMEY_FREE(ctx, ctx->lazy.slots);
+
+		memset(slots, 0, size);
+		ctx->lazy.slots = slots;
+		ctx->lazy.cap = ctx->dict.nargs;
+		ctx->lazy.gen = 0;
+	}
+
+	/* Generation 0 marks never used slots */
+	if (++ctx->lazy.gen == 0) {
+		memset(ctx->lazy.slots, 0, ctx->lazy.cap * sizeof(struct __wimey_lazy_slot));
+		ctx->lazy.gen = 1;
+	}
+
+	return true;
+}
+
+/* Start the slots of a lazy parse with the set entries of
+ * `base` (generation not 0): the config file values, or the
+ * values a stream starts every line with */
+static void __wimey_lazy_seed(struct wimey_ctx *ctx, const struct __wimey_lazy_slot *base,
+			      size_t n) {
+	for (size_t i = 0; i < n && i < ctx->lazy.cap; i++)
+		if (base[i].gen != 0)
+			__wimey_lazy_keep(&ctx->lazy.slots[i], ctx->lazy.gen, base[i].raw);
+}
+
+/* Node of `key` (long or short): global arguments first, then
+ * the ones of subcommands whatever their command */
+static struct __wimey_argument_node *__wimey_argument_by_key(struct wimey_ctx *ctx,
+							      const char *key) {
+	struct __wimey_argument_node *node = __wimey_get_argument_node(ctx, 0, (char *)key);
+
+	for (size_t i = 0; node == NULL && i < ctx->dict.nargs; i++)
+		if (__wimey_argument_key_of(&ctx->dict.args[i], key) != NULL)
+			node = &ctx->dict.args[i];
+
+	if (node == NULL)
+		WARN(ctx, "Unknown argument %s", key);
+
+	return node;
+}
+
+/* Slot of `key` (long or short) if it was given to the last
+ * lazy parse, NULL otherwise */
+static struct __wimey_lazy_slot *__wimey_lazy_find(struct wimey_ctx *ctx, const char *key,
+						    const struct wimey_argument_t **arg) {
+	struct __wimey_argument_node *node;
+	struct __wimey_lazy_slot *slot;
+
+	if (ctx->lazy.slots == NULL || key == NULL)
+		return NULL;
+
+	node = __wimey_argument_by_key(ctx, key);
+	if (node == NULL)
+		return NULL;
+
+	slot = &ctx->lazy.slots[node - ctx->dict.args];
+	if (slot->gen != ctx->lazy.gen)
+		return NULL;
+
+	*arg = &node->argument;
+	return slot;
+}
+
+/* Lazy slot of a numeric argument, converted on the first
+ * call and memoized. NULL if missing or invalid */
+static struct __wimey_lazy_slot *__wimey_lazy_value(struct wimey_ctx *ctx, const char *key,
+						     enum wimey_argument_type type) {
+	const struct wimey_argument_t *arg;
+	struct __wimey_lazy_slot *slot = __wimey_lazy_find(ctx, key, &arg);
+	const char *val;
+	int ret;
+
+	if (slot == NULL)
+		return NULL;
+
+	if (arg->value_type != type) {
+		ERR(ctx, "Argument %s has a different type", arg->long_key);
+		return NULL;
+	}
+
+	if (slot->state == __WIMEY_LAZY_RAW) {
+		val = slot->raw;
+		__WIMEY_STAT(ctx, conversions, 1);
+
+		if (type == WIMEY_LONG)
+			ret = wimey_val_parse_long(val, &slot->value.l);
+		else
+			ret = wimey_val_parse_double(val, &slot->value.d);
+
+		slot->state = ret == WIMEY_OK ? __WIMEY_LAZY_DONE : __WIMEY_LAZY_FAILED;
+		if (ret != WIMEY_OK)
+			ERR(ctx, "Invalid value `%s` for %s", val, arg->long_key);
+	}
+
+	return slot->state == __WIMEY_LAZY_DONE ? slot : NULL;
+}
+
+/* Check if an argument was given
+ * ------------------------------
+ * Lazy mode only, `key` is the long or the short key.
+ * Returns: true if the last parse saw the argument */
+int wimey_ctx_is_set(struct wimey_ctx *ctx, const char *key) {
+	const struct wimey_argument_t *arg;
+
+	return __wimey_lazy_find(ctx, key, &arg) != NULL;
+}
+
+/* Typed accessors for lazy mode: the value is converted on the
+ * first call and memoized. Missing arguments, type mismatches
+ * and invalid values read as 0 (or NULL), see wimey_ctx_is_set() */
+long wimey_ctx_get_long(struct wimey_ctx *ctx, const char *key) {
+	struct __wimey_lazy_slot *slot = __wimey_lazy_value(ctx, key, WIMEY_LONG);
+
+	return slot != NULL ? slot->value.l : 0;
+}
+
+double wimey_ctx_get_double(struct wimey_ctx *ctx, const char *key) {
+	struct __wimey_lazy_slot *slot = __wimey_lazy_value(ctx, key, WIMEY_DOUBLE);
+
+	return slot != NULL ? slot->value.d : 0;
+}
+
+/* Strings point into the parsed argv */
+const char *wimey_ctx_get_str(struct wimey_ctx *ctx, const char *key) {
+	const struct wimey_argument_t *arg;
+	struct __wimey_lazy_slot *slot = __wimey_lazy_find(ctx, key, &arg);
+
+	if (slot == NULL)
+		return NULL;
+
+	if (arg->value_type != WIMEY_STR) {
+		ERR(ctx, "Argument %s has a different type", arg->long_key);
+		return NULL;
+	}
+
+	return slot->raw;
+}
+
+int wimey_ctx_get_bool(struct wimey_ctx *ctx, const char *key) {
+	return wimey_ctx_is_set(ctx, key);
+}
+
+/* Initialize a context with default configuration */
+int wimey_ctx_init(struct wimey_ctx *ctx) {
+	return wimey_ctx_init_with_capacity(ctx, 0, 0);
+}
+
+/* Initialize a context reserving room for `ncmds` commands
+ * and `nargs` arguments, so registration never reallocates */
+int wimey_ctx_init_with_capacity(struct wimey_ctx *ctx, size_t ncmds, size_t nargs) {
+	wimey_ctx_free_all(ctx);
+	wimey_ctx_reset_stats(ctx);
+
+	if (ncmds > 0) {
+		if (!__wimey_resize(ctx, (void **)&ctx->dict.cmds, 0, ncmds,
+				    sizeof(struct __wimey_command_node)))
+			goto err;
+		ctx->dict.cmds_cap = ncmds;
+	}
+
+	if (nargs > 0) {
+		if (!__wimey_resize(ctx, (void **)&ctx->dict.args, 0, nargs,
+				    sizeof(struct __wimey_argument_node)))
+			goto err;
+		ctx->dict.args_cap = nargs;
+	}
+
+	return WIMEY_OK;
+
+err:
+	ERR(ctx, "Failed to reserve registry capacity");
+	wimey_ctx_free_all(ctx);
+	return WIMEY_ERR;
+}
+
+/* Replace the allocator used for the registry and its index
+ * -------------------------------------------------------
+ * Arguments:
+ *  struct wimey_ctx *ctx - Parser context
+ *  const struct wimey_allocator_t *allocator - hooks, NULL restores malloc/free
+ * Returns: WIMEY_ERR if the registry already holds memory */
+int wimey_ctx_set_allocator(struct wimey_ctx *ctx,
+			    const struct wimey_allocator_t *allocator) {
+	if (ctx->dict.cmds != NULL || ctx->dict.args != NULL
+	    || ctx->dict.cmd_slots != NULL || ctx->dict.arg_slots != NULL
+	    || ctx->help.text != NULL || ctx->lazy.slots != NULL
+	    || ctx->argfiles.maps != NULL || ctx->argfiles.argv != NULL
+	    || ctx->configs.maps != NULL || ctx->lists.slots != NULL
+	    || ctx->delta.offs != NULL) {
+		ERR(ctx, "Allocator must be set before registering anything");
+		return WIMEY_ERR;
+	}
+
+	if (allocator == NULL) {
+		ctx->allocator.alloc = __wimey_default_alloc;
+		ctx->allocator.free = __wimey_default_free;
+		ctx->allocator.user = NULL;
+		return WIMEY_OK;
+	}
+
+	if (allocator->alloc == NULL || allocator->free == NULL)
+		return WIMEY_ERR;
+
+	ctx->allocator = *allocator;
+	return WIMEY_OK;
+}
+
+/* Seal the registry and build the lookup index
+ * --------------------------------------------
+ * After this call every command and argument key is resolved
+ * with a single hash lookup instead of a list walk.
+ * New commands and arguments can't be added until wimey_free_all().
+ * Returns: WIMEY_OK on success, WIMEY_ERR on allocation failure */
+int wimey_ctx_finalize(struct wimey_ctx *ctx) {
+	if (ctx->dict.sealed)
+		return WIMEY_OK;
+
+	if (!__wimey_rules_compile(ctx))
+		return WIMEY_ERR;
+
+	size_t nenv = 0;
+
+	for (size_t i = 0; i < ctx->dict.nargs; i++)
+		nenv += ctx->dict.args[i].argument.env_key != NULL;
+
+	size_t cmd_size = __wimey_index_size(ctx->dict.ncmds);
+	size_t arg_size = __wimey_index_size(ctx->dict.nargs * 2); /* long and short key */
+	size_t env_size = __wimey_index_size(nenv);
+
+	ctx->dict.cmd_slots = __WIMEY_ALLOC(ctx, cmd_size * sizeof(struct __wimey_index_slot));
+	ctx->dict.arg_slots = __WIMEY_ALLOC(ctx, arg_size * sizeof(struct __wimey_index_slot));
+	ctx->dict.env_slots = __WIMEY_ALLOC(ctx, env_size * sizeof(struct __wimey_index_slot));
+
+	if (!ctx->dict.cmd_slots || !ctx->dict.arg_slots || !ctx->dict.env_slots) {
+		ERR(ctx, "Failed to allocate registry index");
+		__wimey_index_free(ctx);
+		return WIMEY_ERR;
+	}
+
+	memset(ctx->dict.cmd_slots, 0, cmd_size * sizeof(struct __wimey_index_slot));
+	memset(ctx->dict.arg_slots, 0, arg_size * sizeof(struct __wimey_index_slot));
+	memset(ctx->dict.env_slots, 0, env_size * sizeof(struct __wimey_index_slot));
+
+	ctx->dict.cmd_mask = cmd_size - 1;
+	ctx->dict.arg_mask = arg_size - 1;
+	ctx->dict.env_mask = env_size - 1;
+	ctx->dict.nenv = nenv;
+
+	for (struct __wimey_command_node *c = wimey_ctx_get_commands_head(ctx); c; c = c->next)
+		__wimey_index_insert(ctx->dict.cmd_slots, ctx->dict.cmd_mask, c->level,
+				     c->cmd.key, c, __wimey_command_key_of);
+
+	for (struct __wimey_argument_node *a = wimey_ctx_get_arguments_head(ctx); a; a = a->next) {
+		__wimey_index_insert(ctx->dict.arg_slots, ctx->dict.arg_mask, a->level,
+				     a->argument.long_key, a,
+				     __wimey_argument_key_of);
+		__wimey_index_insert(ctx->dict.arg_slots, ctx->dict.arg_mask, a->level,
+				     a->argument.short_key, a,
+				     __wimey_argument_key_of);
+		__wimey_index_insert(ctx->dict.env_slots, ctx->dict.env_mask, 0,
+				     a->argument.env_key, a,
+				     __wimey_env_key_of);
+
+		const char *skey = a->argument.short_key;
+
+		/* First registered wins, like the index. Only global
+		 * arguments, scoped ones go through the index */
+		if (a->level == 0 && __wimey_is_short_char(skey)
+		    && ctx->dict.shorts[(unsigned char)skey[1]] == 0)
+			ctx->dict.shorts[(unsigned char)skey[1]] = a - ctx->dict.args + 1;
+	}
+
+	ctx->dict.sealed = true;
+	return WIMEY_OK;
+}
+
+/* Wrapper for internal parsing functions */
+int wimey_ctx_parse(struct wimey_ctx *ctx, int argc, char **argv) {
+	struct __wimey_schema schema = __wimey_registry_schema(ctx);
+
+	struct __wimey_sink sink = { .batch = NULL };
+
+	ctx->str_used = 0;
+	__wimey_error_reset(ctx);
+	if (ctx->conf.response_files && !__wimey_argfiles_expand(ctx, &argc, &argv))
+		return WIMEY_ERR;
+
+	/* Lazy values start from the config files, then the
+	 * environment, like value_dest */
+	if (ctx->conf.lazy) {
+		if (!__wimey_lazy_begin(ctx))
+			return WIMEY_ERR;
+		__wimey_lazy_seed(ctx, ctx->lazy.preset, ctx->lazy.preset_cap);
+		sink.lazy = true;
+	}
+
+	if (!__wimey_rules_begin(ctx) || !__wimey_apply_env(ctx))
+		return WIMEY_ERR;
+
+	return __wimey_parse_tokens(&schema, &sink, argc, argv);
+}
+
+/* ------- Incremental re-parse ------- */
+
+/* Snapshot marks: the argument wasn't given, or was a flag */
+#define __WIMEY_DELTA_UNSET ((size_t)-1)
+#define __WIMEY_DELTA_FLAG ((size_t)-2)
+
+/* Room for the snapshot of every registered argument, new
+ * arguments start unset */
+static bool __wimey_delta_reserve(struct wimey_ctx *ctx) {
+	size_t nargs = ctx->dict.nargs;
+	size_t words = (nargs + 63) / 64;
+
+	if (ctx->delta.cap >= nargs && ctx->delta.offs != NULL)
+		return true;
+
+	size_t *offs = __WIMEY_ALLOC(ctx, nargs * sizeof(size_t) + 1);
+	uint64_t *bits = __WIMEY_ALLOC(ctx, words * sizeof(uint64_t) + 1);
+
+	if (offs == NULL || bits == NULL) {
+		if (offs != NULL)
+			__WIMEY_FREE(ctx, offs);
+		if (bits != NULL)
+			__WIMEY_FREE(ctx, bits);
+		ERR(ctx, "Failed to allocate re-parse state");
+		__wimey_fail(ctx, WIMEY_E_NO_MEMORY, NULL, NULL);
+		return false;
+	}
+
+	for (size_t i = 0; i < nargs; i++)
+		offs[i] = i < ctx->delta.cap ? ctx->delta.offs[i] : __WIMEY_DELTA_UNSET;
+
+	if (ctx->delta.offs != NULL)
+		__WIMEY_FREE(ctx, ctx->delta.offs);
+	if (ctx->delta.bits != NULL)
+		__WIMEY_FREE(ctx, ctx->delta.bits);
+
+	ctx->delta.offs = offs;
+	ctx->delta.bits = bits;
+	ctx->delta.cap = nargs;
+	return true;
+}
+
+static void __wimey_delta_free(struct wimey_ctx *ctx) {
+	if (ctx->delta.offs != NULL)
+		__WIMEY_FREE(ctx, ctx->delta.offs);
+	if (ctx->delta.bits != NULL)
+		__WIMEY_FREE(ctx, ctx->delta.bits);
+	if (ctx->delta.pool != NULL)
+		__WIMEY_FREE(ctx, ctx->delta.pool);
+
+	ctx->delta.offs = NULL;
+	ctx->delta.bits = NULL;
+	ctx->delta.pool = NULL;
+	ctx->delta.cap = ctx->delta.pool_len = 0;
+}
+
+/* Re-parse argv against the last re-parse
+ * ---------------------------------------
+ * argv is recorded like a lazy parse, then each argument is
+ * compared with its value of the previous call: only the ones
+ * that changed are converted and written to value_dest. A flag
+ * that is gone is cleared, a value that is gone is left as is.
+ * Lists are rebuilt and reported whenever given. Command
+ * callbacks are not run and the environment is not applied.
+ * A rejected line writes nothing (lists aside) and keeps the
+ * snapshot, a value that doesn't convert drops it so the next
+ * call writes every given argument again.
+ * Returns: bitmap of the changed arguments (registry order,
+ * valid until the next call) or NULL on error */
+const uint64_t *wimey_ctx_reparse_delta(struct wimey_ctx *ctx, int argc, char **argv) {
+	struct __wimey_schema schema = __wimey_registry_schema(ctx);
+	struct __wimey_sink sink = { .batch = NULL, .lazy = true, .delta = true };
+	size_t nargs = ctx->dict.nargs;
+	size_t pool_len = 0;
+	char *pool = NULL;
+
+	ctx->str_used = 0;
+	__wimey_error_reset(ctx);
+	if (ctx->conf.response_files && !__wimey_argfiles_expand(ctx, &argc, &argv))
+		return NULL;
+
+	if (!__wimey_delta_reserve(ctx) || !__wimey_lazy_begin(ctx)
+	    || !__wimey_rules_begin(ctx))
+		return NULL;
+
+	if (__wimey_parse_tokens(&schema, &sink, argc, argv) != WIMEY_OK)
+		return NULL;
+
+	/* The new snapshot in one block */
+	for (size_t i = 0; i < nargs; i++) {
+		const struct __wimey_lazy_slot *slot = &ctx->lazy.slots[i];
+
+		if (slot->gen == ctx->lazy.gen && slot->raw != NULL)
+			pool_len += strlen(slot->raw) + 1;
+	}
+
+	if (pool_len > 0) {
+		pool = __WIMEY_ALLOC(ctx, pool_len);
+		if (pool == NULL) {
+			ERR(ctx, "Failed to allocate re-parse state");
+			__wimey_fail(ctx, WIMEY_E_NO_MEMORY, NULL, NULL);
+			return NULL;
+		}
+	}
+
+	memset(ctx->delta.bits, 0, (nargs + 63) / 64 * sizeof(uint64_t));
+
+	for (size_t i = 0, used = 0; i < nargs; i++) {
+		const struct __wimey_lazy_slot *slot = &ctx->lazy.slots[i];
+		const struct wimey_argument_t *arg = &ctx->dict.args[i].argument;
+		size_t old = ctx->delta.offs[i], off = __WIMEY_DELTA_UNSET;
+
+		if (slot->gen == ctx->lazy.gen) {
+			off = __WIMEY_DELTA_FLAG;
+			if (slot->raw != NULL) {
+				size_t len = strlen(slot->raw) + 1;
+
+				memcpy(pool + used, slot->raw, len);
+				off = used;
+				used += len;
+			}
+		}
+
+		bool changed = off != old;
+
+		if (off < __WIMEY_DELTA_FLAG && old < __WIMEY_DELTA_FLAG)
+			changed = strcmp(pool + off, ctx->delta.pool + old) != 0;
+		if (__wimey_is_list(arg->value_type))
+			changed = off != __WIMEY_DELTA_UNSET || old != __WIMEY_DELTA_UNSET;
+
+		ctx->delta.offs[i] = off;
+		if (changed)
+			ctx->delta.bits[i / 64] |= (uint64_t)1 << (i % 64);
+	}
+
+	/* Write the changed values, lists are already stored */
+	for (size_t i = 0; i < nargs && !ctx->conf.lazy; i++) {
+		const struct wimey_argument_t *arg = &ctx->dict.args[i].argument;
+		size_t off = ctx->delta.offs[i];
+
+		if (!(ctx->delta.bits[i / 64] >> (i % 64) & 1)
+		    || __wimey_is_list(arg->value_type))
+			continue;
+
+		if (off == __WIMEY_DELTA_UNSET) {
+			if (__wimey_is_flag(arg) && arg->value_dest != NULL)
+				*(int *)arg->value_dest = false;
+			continue;
+		}
+
+		if (!__wimey_process_argument(ctx, arg, ctx->lazy.slots[i].raw))
+			goto err;
+	}
+
+	if (ctx->delta.pool != NULL)
+		__WIMEY_FREE(ctx, ctx->delta.pool);
+	ctx->delta.pool = pool;
+	ctx->delta.pool_len = pool_len;
+	return ctx->delta.bits;
+
+err:
+	/* Forget the snapshot, the next call compares against nothing */
+	for (size_t i = 0; i < nargs; i++)
+		ctx->delta.offs[i] = __WIMEY_DELTA_UNSET;
+	if (pool != NULL)
+		__WIMEY_FREE(ctx, pool);
+	if (ctx->delta.pool != NULL)
+		__WIMEY_FREE(ctx, ctx->delta.pool);
+	ctx->delta.pool = NULL;
+	ctx->delta.pool_len = 0;
+	return NULL;
+}
+
+/* ------- Serialization ------- */
+
+/* Wire format of wimey_serialize_results(), native byte order:
+ * a header, one record per registered argument (registry order)
+ * and a blob. Strings are NUL terminated in the blob, numeric
+ * lists are arrays of int64_t or double aligned to 8, string lists
+ * are arrays of uint64_t blob offsets. Offsets are from the start
+ * of the blob. Every item is converted from and to its native
+ * type, a long that doesn't fit the reader's long is rejected. */
+#define __WIMEY_WIRE_MAGIC 0x594d4957u	/* "WIMY" */
+#define __WIMEY_WIRE_VERSION 1
+
+struct __wimey_wire_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t reserved;
+	uint32_t nargs;
+	uint32_t schema;	/* hash of the keys and types */
+	uint64_t blob_len;
+};
+
+struct __wimey_wire_record {
+	uint16_t type;		/* value_type */
+	uint16_t set;		/* 1 if the record holds a value */
+	uint32_t aux;		/* string length or list count */
+	uint64_t payload;	/* long, double bits or blob offset */
+};
+
+/* Output of the serializer: the size is counted even past
+ * `len`, so the same pass tells how much room is needed */
+struct __wimey_wire {
+	char *buf;
+	size_t len;
+	size_t pos;
+};
+
+static void __wimey_wire_put(struct __wimey_wire *w, size_t at, const void *data, size_t n) {
+	if (w->buf != NULL && at + n <= w->len)
+		memcpy(w->buf + at, data, n);
+}
+
+/* Append `n` bytes aligned to `align`, returns their position */
+static size_t __wimey_wire_append(struct __wimey_wire *w, const void *data, size_t n,
+				  size_t align) {
+	static const char zeros[8];
+
+	while (w->pos % align != 0)
+		__wimey_wire_put(w, w->pos++, zeros, 1);
+
+	size_t at = w->pos;
+
+	if (data != NULL)
+		__wimey_wire_put(w, at, data, n);
+	w->pos += n;
+	return at;
+}
+
+/* Hash of what the records depend on, both sides must have
+ * registered the same arguments in the same order */
+static uint32_t __wimey_schema_hash(struct wimey_ctx *ctx) {
+	uint32_t hash = __WIMEY_HASH_SEED;
+
+	for (size_t i = 0; i < ctx->dict.nargs; i++) {
+		const struct wimey_argument_t *arg = &ctx->dict.args[i].argument;
+
+		hash = __wimey_hash_from(hash, arg->long_key != NULL ? arg->long_key : "");
+		hash = __wimey_hash_from(hash, arg->short_key != NULL ? arg->short_key : "");
+		hash ^= arg->value_type;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/* Current value of the i-th argument: value_dest, or the lazy
+ * slot in lazy mode. Returns false if there is none. */
+static bool __wimey_result_of(struct wimey_ctx *ctx, size_t i, union wimey_value_t *value) {
+	const struct wimey_argument_t *arg = &ctx->dict.args[i].argument;
+
+	/* Opaque, only parse_fn knows what the destination holds */
+	if (arg->value_type == WIMEY_CUSTOM)
+		return false;
+
+	if (ctx->conf.lazy && !__wimey_is_list(arg->value_type)) {
+		const struct __wimey_lazy_slot *slot =
+			i < ctx->lazy.cap ? &ctx->lazy.slots[i] : NULL;
+
+		if (slot == NULL || slot->gen != ctx->lazy.gen || ctx->lazy.gen == 0)
+			return false;
+
+		if (__wimey_is_flag(arg)) {
+			value->b = true;
+			return true;
+		}
+
+		switch (arg->value_type) {
+		case WIMEY_LONG:
+			return wimey_val_parse_long(slot->raw, &value->l) == WIMEY_OK;
+		case WIMEY_DOUBLE:
+			return wimey_val_parse_double(slot->raw, &value->d) == WIMEY_OK;
+		default:
+			value->s = slot->raw;
+			return true;
+		}
+	}
+
+	if (arg->value_dest == NULL)
+		return false;
+
+	if (__wimey_is_flag(arg)) {
+		value->b = *(int *)arg->value_dest;
+		return true;
+	}
+
+	switch (arg->value_type) {
+	case WIMEY_LONG:
+		value->l = *(long *)arg->value_dest;
+		break;
+	case WIMEY_DOUBLE:
+		value->d = *(double *)arg->value_dest;
+		break;
+	case WIMEY_STR:
+		value->s = *(char **)arg->value_dest;
+		return value->s != NULL;
+	default:
+		break;
+	}
+
+	return true;
+}
+
+/* Serialize the parse results
+ * ---------------------------
+ * Writes the value of every registered argument to `buf` in
+ * the wire format above: long, double and flags inline, strings
+ * and lists in the blob. Values are read from value_dest (the
+ * lazy slots in lazy mode), so any parse or load counts.
+ * Returns: the size of the encoding like snprintf(), nothing is
+ * written if `len` is too small, 0 on error */
+size_t wimey_ctx_serialize_results(struct wimey_ctx *ctx, void *buf, size_t len) {
+	size_t nargs = ctx->dict.nargs;
+	size_t records = sizeof(struct __wimey_wire_header);
+	size_t blob = records + nargs * sizeof(struct __wimey_wire_record);
+	struct __wimey_wire w = { .buf = NULL, .len = len };
+
+	/* First pass sizes, the second writes if it fits */
+	for (int pass = 0; pass < 2; pass++) {
+		w.pos = blob;
+
+		for (size_t i = 0; i < nargs; i++) {
+			const struct wimey_argument_t *arg = &ctx->dict.args[i].argument;
+			struct __wimey_wire_record rec = { .type = arg->value_type };
+			union wimey_value_t value;
+
+			if (__wimey_is_list(arg->value_type)) {
+				const struct wimey_list_t *list = arg->value_dest;
+
+				if (list != NULL) {
+					if (list->count > UINT32_MAX)
+						goto err;
+
+					size_t at = __wimey_wire_append(&w, NULL, list->count * 8, 8);
+
+					rec.set = 1;
+					rec.aux = list->count;
+					rec.payload = at - blob;
+
+					for (size_t j = 0; j < list->count; j++) {
+						uint64_t item;
+
+						if (arg->value_type == WIMEY_STR_LIST) {
+							const char *str = ((char **)list->items)[j];
+
+							item = __wimey_wire_append(&w, str, strlen(str) + 1, 1)
+							       - blob;
+						} else if (arg->value_type == WIMEY_LONG_LIST) {
+							int64_t l = ((const long *)list->items)[j];
+
+							memcpy(&item, &l, 8);
+						} else {
+							double d = ((const double *)list->items)[j];
+
+							memcpy(&item, &d, 8);
+						}
+						__wimey_wire_put(&w, at + j * 8, &item, 8);
+					}
+				}
+			} else if (__wimey_result_of(ctx, i, &value)) {
+				rec.set = 1;
+				if (__wimey_is_flag(arg)) {
+					rec.type = WIMEY_BOOL;
+					rec.payload = value.b != 0;
+				} else if (arg->value_type == WIMEY_LONG) {
+					int64_t l = value.l;
+
+					memcpy(&rec.payload, &l, 8);
+				} else if (arg->value_type == WIMEY_DOUBLE) {
+					memcpy(&rec.payload, &value.d, 8);
+				} else {
+					size_t slen = strlen(value.s);
+
+					if (slen > UINT32_MAX)
+						goto err;
+					rec.aux = slen;
+					rec.payload = __wimey_wire_append(&w, value.s, slen + 1, 1) - blob;
+				}
+			}
+
+			__wimey_wire_put(&w, records + i * sizeof(rec), &rec, sizeof(rec));
+		}
+
+		struct __wimey_wire_header head = {
+			.magic = __WIMEY_WIRE_MAGIC,
+			.version = __WIMEY_WIRE_VERSION,
+			.nargs = nargs,
+			.schema = __wimey_schema_hash(ctx),
+			.blob_len = w.pos - blob
+		};
+
+		__wimey_wire_put(&w, 0, &head, sizeof(head));
+
+		if (pass == 1 || buf == NULL || w.pos > len)
+			break;
+		w.buf = buf;
+	}
+
+	return w.pos;
+
+err:
+	ERR(ctx, "Value too large to serialize");
+	return 0;
+}
+
+/* If the int64_t stored in `bits` fits a long of this machine */
+static bool __wimey_wire_long_fits(uint64_t bits) {
+	int64_t l;
+
+	memcpy(&l, &bits, 8);
+	return l >= LONG_MIN && l <= LONG_MAX;
+}
+
+/* Blob string at `off`, NUL terminated within the blob,
+ * of length `slen`. NULL if it's out of bounds. */
+static const char *__wimey_wire_str(const char *blob, uint64_t blob_len,
+				    uint64_t off, uint64_t slen) {
+	if (off >= blob_len || slen >= blob_len - off || blob[off + slen] != '\0')
+		return NULL;
+	return blob + off;
+}
+
+/* Length of the blob string at `off`, blob_len if it has no NUL */
+static uint64_t __wimey_wire_strlen(const char *blob, uint64_t blob_len, uint64_t off) {
+	const char *end;
+
+	if (off >= blob_len)
+		return blob_len;
+
+	end = memchr(blob + off, '\0', blob_len - off);
+	return end != NULL ? (uint64_t)(end - blob) - off : blob_len;
+}
+
+/* Deserialize parse results
+ * -------------------------
+ * Reads a buffer of wimey_ctx_serialize_results() made by a
+ * context with the same arguments and writes the values to
+ * value_dest. Strings point into `buf`, which must outlive them
+ * and be 8 byte aligned, lists are copied to the list storage.
+ * The whole buffer is checked before anything is written.
+ * Returns: WIMEY_OK, WIMEY_ERR on a malformed or foreign buffer */
+int wimey_ctx_deserialize_results(struct wimey_ctx *ctx, const void *buf, size_t len) {
+	const struct __wimey_wire_header *head = buf;
+	size_t nargs = ctx->dict.nargs;
+	size_t records = sizeof(struct __wimey_wire_header);
+	size_t blob = records + nargs * sizeof(struct __wimey_wire_record);
+
+	__wimey_error_reset(ctx);
+
+	if (buf == NULL || (uintptr_t)buf % 8 != 0 || len < records
+	    || head->magic != __WIMEY_WIRE_MAGIC || head->version != __WIMEY_WIRE_VERSION
+	    || head->nargs != nargs || len < blob || head->blob_len > len - blob
+	    || head->schema != __wimey_schema_hash(ctx))
+		goto err;
+
+	const struct __wimey_wire_record *recs =
+		(const struct __wimey_wire_record *)((const char *)buf + records);
+	const char *data = (const char *)buf + blob;
+	uint64_t blob_len = head->blob_len;
+
+	/* Every source replaces the lists, this buffer is one */
+	ctx->lists.gen++;
+
+	/* Validate, then write */
+	for (int pass = 0; pass < 2; pass++) {
+		for (size_t i = 0; i < nargs; i++) {
+			const struct wimey_argument_t *arg = &ctx->dict.args[i].argument;
+			const struct __wimey_wire_record *rec = &recs[i];
+			bool list = __wimey_is_list(arg->value_type);
+			const char *str = NULL;
+
+			if (!rec->set)
+				continue;
+			if (rec->type == WIMEY_CUSTOM || rec->type != (list || !__wimey_is_flag(arg) ? arg->value_type
+									 : WIMEY_BOOL))
+				goto err;
+
+			if (list) {
+				uint64_t off = rec->payload, n = rec->aux;
+
+				if (off % 8 != 0 || off > blob_len || n > (blob_len - off) / 8)
+					goto err;
+
+				const uint64_t *items = (const uint64_t *)(data + off);
+
+				for (size_t j = 0; pass == 0 && arg->value_type == WIMEY_STR_LIST
+						   && j < n; j++)
+					if (__wimey_wire_strlen(data, blob_len, items[j]) == blob_len)
+						goto err;
+
+				for (size_t j = 0; pass == 0 && arg->value_type == WIMEY_LONG_LIST
+						   && j < n; j++)
+					if (!__wimey_wire_long_fits(items[j]))
+						goto err;
+
+				if (pass == 0 || arg->value_dest == NULL)
+					continue;
+
+				struct __wimey_list_slot *slot = __wimey_list_slot(ctx, arg->value_dest);
+
+				if (slot == NULL || !__wimey_list_reserve(ctx, slot, n))
+					goto oom;
+
+				struct wimey_list_t *dest = slot->dest;
+
+				for (size_t j = 0; j < n; j++) {
+					if (arg->value_type == WIMEY_STR_LIST) {
+						((const char **)dest->items)[j] = data + items[j];
+					} else if (arg->value_type == WIMEY_LONG_LIST) {
+						int64_t l;
+
+						memcpy(&l, &items[j], 8);
+						((long *)dest->items)[j] = l;
+					} else {
+						memcpy(&((double *)dest->items)[j], &items[j], 8);
+					}
+				}
+				dest->count = n;
+				continue;
+			}
+
+			if (rec->type == WIMEY_STR) {
+				str = __wimey_wire_str(data, blob_len, rec->payload, rec->aux);
+				if (str == NULL)
+					goto err;
+			}
+
+			if (rec->type == WIMEY_LONG && !__wimey_wire_long_fits(rec->payload))
+				goto err;
+
+			if (pass == 0 || arg->value_dest == NULL)
+				continue;
+
+			if (rec->type == WIMEY_BOOL) {
+				*(int *)arg->value_dest = rec->payload != 0;
+			} else if (rec->type == WIMEY_LONG) {
+				int64_t l;
+
+				memcpy(&l, &rec->payload, 8);
+				*(long *)arg->value_dest = l;
+			} else if (rec->type == WIMEY_DOUBLE) {
+				memcpy(arg->value_dest, &rec->payload, 8);
+			} else {
+				*(const char **)arg->value_dest = str;
+			}
+		}
+	}
+
+	return WIMEY_OK;
+
+err:
+	ERR(ctx, "Invalid or foreign serialized results");
+	__wimey_fail(ctx, WIMEY_E_FORMAT, NULL, NULL);
+	return WIMEY_ERR;
+
+oom:
+	__wimey_fail(ctx, WIMEY_E_NO_MEMORY, NULL, NULL);
+	return WIMEY_ERR;
+}
+
+/* ------- Schema snapshots ------- */
+
+/* File written by wimey_save_schema(): the sealed registry as
+ * laid out in memory, native byte order and word size. Pointers
+ * to strings are offsets from the start of the file (0 for NULL),
+ * index slots hold the node position + 1. Loading maps the file
+ * privately and turns the offsets back into pointers in place. */
+#define __WIMEY_SNAP_MAGIC 0x534d4957u	/* "WIMS" */
+#define __WIMEY_SNAP_VERSION 2
+
+struct __wimey_snap_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t word;		/* sizeof(void *) */
+	uint32_t cmd_node;	/* sizeof(struct __wimey_command_node) */
+	uint32_t arg_node;	/* sizeof(struct __wimey_argument_node) */
+	uint64_t len;		/* file size */
+	uint64_t ncmds, nargs, nenv;
+	uint64_t cmd_size, arg_size, env_size;	/* index slots */
+	/* Section offsets, strings run to the end of the file */
+	uint64_t cmds, args, cmd_slots, arg_slots, env_slots, strings;
+	uint32_t shorts[256];
+};
+
+/* Append a string, returns its offset as a pointer */
+static char *__wimey_snap_str(struct __wimey_wire *w, const char *str) {
+	if (str == NULL)
+		return NULL;
+
+	return (char *)(uintptr_t)__wimey_wire_append(w, str, strlen(str) + 1, 1);
+}
+
+/* Copy an index table with node positions instead of pointers */
+static void __wimey_snap_slots(struct __wimey_wire *w, size_t at,
+			       const struct __wimey_index_slot *slots, size_t size,
+			       const void *base, size_t elem) {
+	for (size_t i = 0; i < size; i++) {
+		struct __wimey_index_slot slot = slots[i];
+
+		if (slot.node != NULL)
+			slot.node = (void *)(uintptr_t)
+				((size_t)((char *)slot.node - (char *)base) / elem + 1);
+		__wimey_wire_put(w, at + i * sizeof(slot), &slot, sizeof(slot));
+	}
+}
+
+/* Save the sealed registry
+ * ------------------------
+ * Writes keys, types, help strings, scopes and the hash index
+ * to `path` (the registry is finalized if needed). value_dest
+ * and callbacks are not saved, see wimey_ctx_bind_argument().
+ * Returns: WIMEY_OK or WIMEY_ERR */
+int wimey_ctx_save_schema(struct wimey_ctx *ctx, const char *path) {
+	struct __wimey_wire w = { .buf = NULL, .len = 0 };
+	struct __wimey_snap_header head = {
+		.magic = __WIMEY_SNAP_MAGIC,
+		.version = __WIMEY_SNAP_VERSION,
+		.word = sizeof(void *),
+		.cmd_node = sizeof(struct __wimey_command_node),
+		.arg_node = sizeof(struct __wimey_argument_node)
+	};
+	FILE *out;
+
+	__wimey_error_reset(ctx);
+	if (wimey_ctx_finalize(ctx) != WIMEY_OK) {
+		__wimey_fail(ctx, WIMEY_E_NO_MEMORY, NULL, NULL);
+		return WIMEY_ERR;
+	}
+
+	head.ncmds = ctx->dict.ncmds;
+	head.nargs = ctx->dict.nargs;
+	head.nenv = ctx->dict.nenv;
+	head.cmd_size = ctx->dict.cmd_mask + 1;
+	head.arg_size = ctx->dict.arg_mask + 1;
+	head.env_size = ctx->dict.env_mask + 1;
+	memcpy(head.shorts, ctx->dict.shorts, sizeof(head.shorts));
+
+	/* First pass sizes, the second writes */
+	for (int pass = 0; pass < 2; pass++) {
+		w.pos = sizeof(head);
+		head.cmds = __wimey_wire_append(&w, NULL,
+						head.ncmds * sizeof(struct __wimey_command_node), 8);
+		head.args = __wimey_wire_append(&w, NULL,
+						head.nargs * sizeof(struct __wimey_argument_node), 8);
+		head.cmd_slots = __wimey_wire_append(&w, NULL,
+						     head.cmd_size * sizeof(struct __wimey_index_slot), 8);
+		head.arg_slots = __wimey_wire_append(&w, NULL,
+						     head.arg_size * sizeof(struct __wimey_index_slot), 8);
+		head.env_slots = __wimey_wire_append(&w, NULL,
+						     head.env_size * sizeof(struct __wimey_index_slot), 8);
+		head.strings = w.pos;
+
+		for (size_t i = 0; i < ctx->dict.ncmds; i++) {
+			struct __wimey_command_node node = ctx->dict.cmds[i];
+
+			node.cmd.key = __wimey_snap_str(&w, node.cmd.key);
+			node.cmd.value_name = __wimey_snap_str(&w, node.cmd.value_name);
+			node.cmd.desc = __wimey_snap_str(&w, node.cmd.desc);
+			node.cmd.parent = __wimey_snap_str(&w, node.cmd.parent);
+			node.cmd.callback = NULL;
+			node.next = NULL;
+			__wimey_wire_put(&w, head.cmds + i * sizeof(node), &node, sizeof(node));
+		}
+
+		for (size_t i = 0; i < ctx->dict.nargs; i++) {
+			struct __wimey_argument_node node = ctx->dict.args[i];
+
+			node.argument.long_key = __wimey_snap_str(&w, node.argument.long_key);
+			node.argument.short_key = __wimey_snap_str(&w, node.argument.short_key);
+			node.argument.value_name = __wimey_snap_str(&w, node.argument.value_name);
+			node.argument.desc = __wimey_snap_str(&w, node.argument.desc);
+			node.argument.env_key = __wimey_snap_str(&w, node.argument.env_key);
+			node.argument.command = __wimey_snap_str(&w, node.argument.command);
+			node.argument.requires = __wimey_snap_str(&w, node.argument.requires);
+			node.argument.conflicts = __wimey_snap_str(&w, node.argument.conflicts);
+			node.argument.value_dest = NULL;
+			node.argument.parse_fn = NULL;
+			node.next = NULL;
+			__wimey_wire_put(&w, head.args + i * sizeof(node), &node, sizeof(node));
+		}
+
+		__wimey_snap_slots(&w, head.cmd_slots, ctx->dict.cmd_slots, head.cmd_size,
+				   ctx->dict.cmds, sizeof(struct __wimey_command_node));
+		__wimey_snap_slots(&w, head.arg_slots, ctx->dict.arg_slots, head.arg_size,
+				   ctx->dict.args, sizeof(struct __wimey_argument_node));
+		__wimey_snap_slots(&w, head.env_slots, ctx->dict.env_slots, head.env_size,
+				   ctx->dict.args, sizeof(struct __wimey_argument_node));
+
+		head.len = w.pos;
+		__wimey_wire_put(&w, 0, &head, sizeof(head));
+
+		if (pass == 1)
+			break;
+
+		w.buf = __WIMEY_ALLOC(ctx, w.pos);
+		w.len = w.pos;
+		if (w.buf == NULL) {
+			ERR(ctx, "Failed to allocate schema %s", path);
+			__wimey_fail(ctx, WIMEY_E_NO_MEMORY, NULL, path);
+			return WIMEY_ERR;
+		}
+		memset(w.buf, 0, w.len);
+	}
+
+	out = fopen(path, "wb");
+	if (out == NULL)
+		goto err;
+
+	if (fwrite(w.buf, 1, w.len, out) != w.len) {
+		fclose(out);
+		goto err;
+	}
+
+	if (fclose(out) != 0)
+		goto err;
+
+	__WIMEY_FREE(ctx, w.buf);
+	return WIMEY_OK;
+
+err:
+	ERR(ctx, "Failed to write schema %s", path);
+	__wimey_fail(ctx, WIMEY_E_FILE, NULL, path);
+	__WIMEY_FREE(ctx, w.buf);
+	return WIMEY_ERR;
+}
+
+/* Turn a string offset back into a pointer. The mapping has a
+ * spare zero byte past the file, any offset in the string
+ * section is NUL terminated. */
+static bool __wimey_snap_reloc_str(char **str, char *base,
+				   const struct __wimey_snap_header *head) {
+	uintptr_t off = (uintptr_t)*str;
+
+	if (off == 0)
+		return true;
+
+	if (off < head->strings || off >= head->len)
+		return false;
+
+	*str = base + off;
+	return true;
+}
+
+/* Relocate an index table of `size` slots over `count` nodes,
+ * there must be at least one empty slot so probes end */
+static bool __wimey_snap_reloc_slots(struct __wimey_index_slot *slots, size_t size,
+				     char *nodes, size_t count, size_t elem) {
+	size_t used = 0;
+
+	for (size_t i = 0; i < size; i++) {
+		uintptr_t pos = (uintptr_t)slots[i].node;
+
+		if (pos == 0)
+			continue;
+		if (pos > count)
+			return false;
+
+		slots[i].node = nodes + (pos - 1) * elem;
+		used++;
+	}
+
+	return used < size;
+}
+
+/* Is a section of `count` items of `elem` bytes at `off` after
+ * the previous one (ending at `end`) and before the strings */
+static bool __wimey_snap_section(const struct __wimey_snap_header *head, uint64_t *end,
+				 uint64_t off, uint64_t count, size_t elem) {
+	if (off % 8 != 0 || off < *end || off > head->strings
+	    || count > (head->strings - off) / elem)
+		return false;
+
+	*end = off + count * elem;
+	return true;
+}
+
+static bool __wimey_is_pow2(uint64_t n) {
+	return n != 0 && (n & (n - 1)) == 0;
+}
+
+/* Check the header and every offset of a mapped schema file
+ * of `size` bytes and relocate it in place */
+static bool __wimey_snap_relocate(char *base, long size) {
+	struct __wimey_snap_header *head = (struct __wimey_snap_header *)base;
+	struct __wimey_command_node *cmds;
+	struct __wimey_argument_node *args;
+	uint64_t end = sizeof(*head);
+	bool ok = true;
+
+	if ((size_t)size < sizeof(*head) || head->magic != __WIMEY_SNAP_MAGIC
+	    || head->version != __WIMEY_SNAP_VERSION || head->word != sizeof(void *)
+	    || head->cmd_node != sizeof(struct __wimey_command_node)
+	    || head->arg_node != sizeof(struct __wimey_argument_node)
+	    || head->len != (uint64_t)size || head->strings > head->len)
+		return false;
+
+	if (!__wimey_is_pow2(head->cmd_size) || !__wimey_is_pow2(head->arg_size)
+	    || !__wimey_is_pow2(head->env_size) || head->ncmds >= UINT32_MAX
+	    || head->nargs >= UINT32_MAX
+	    || !__wimey_snap_section(head, &end, head->cmds, head->ncmds,
+				     sizeof(struct __wimey_command_node))
+	    || !__wimey_snap_section(head, &end, head->args, head->nargs,
+				     sizeof(struct __wimey_argument_node))
+	    || !__wimey_snap_section(head, &end, head->cmd_slots, head->cmd_size,
+				     sizeof(struct __wimey_index_slot))
+	    || !__wimey_snap_section(head, &end, head->arg_slots, head->arg_size,
+				     sizeof(struct __wimey_index_slot))
+	    || !__wimey_snap_section(head, &end, head->env_slots, head->env_size,
+				     sizeof(struct __wimey_index_slot)))
+		return false;
+
+	cmds = (struct __wimey_command_node *)(base + head->cmds);
+	args = (struct __wimey_argument_node *)(base + head->args);
+
+	/* A parent comes before its children, so walking up the
+	 * levels always ends */
+	for (size_t i = 0; i < head->ncmds; i++) {
+		struct wimey_command_t *cmd = &cmds[i].cmd;
+
+		ok &= __wimey_snap_reloc_str(&cmd->key, base, head) && cmd->key != NULL
+		    && __wimey_snap_reloc_str(&cmd->value_name, base, head)
+		    && __wimey_snap_reloc_str(&cmd->desc, base, head)
+		    && __wimey_snap_reloc_str(&cmd->parent, base, head)
+		    && cmds[i].level <= i;
+		cmd->callback = NULL;
+		cmds[i].next = i + 1 < head->ncmds ? &cmds[i + 1] : NULL;
+	}
+
+	for (size_t i = 0; i < head->nargs; i++) {
+		struct wimey_argument_t *arg = &args[i].argument;
+
+		ok &= __wimey_snap_reloc_str(&arg->long_key, base, head)
+		    && __wimey_snap_reloc_str(&arg->short_key, base, head)
+		    && __wimey_snap_reloc_str(&arg->value_name, base, head)
+		    && __wimey_snap_reloc_str(&arg->desc, base, head)
+		    && __wimey_snap_reloc_str(&arg->env_key, base, head)
+		    && __wimey_snap_reloc_str(&arg->command, base, head)
+		    && __wimey_snap_reloc_str(&arg->requires, base, head)
+		    && __wimey_snap_reloc_str(&arg->conflicts, base, head)
+		    && args[i].level <= head->ncmds;
+		arg->value_dest = NULL;
+		arg->parse_fn = NULL;
+		args[i].next = i + 1 < head->nargs ? &args[i + 1] : NULL;
+	}
+
+	for (size_t i = 0; i < 256; i++)
+		ok &= head->shorts[i] <= head->nargs;
+
+	return ok
+	    && __wimey_snap_reloc_slots((void *)(base + head->cmd_slots), head->cmd_size,
+					(char *)cmds, head->ncmds,
+					sizeof(struct __wimey_command_node))
+	    && __wimey_snap_reloc_slots((void *)(base + head->arg_slots), head->arg_size,
+					(char *)args, head->nargs,
+					sizeof(struct __wimey_argument_node))
+	    && __wimey_snap_reloc_slots((void *)(base + head->env_slots), head->env_size,
+					(char *)args, head->nargs,
+					sizeof(struct __wimey_argument_node));
+}
+
+/* Load a schema saved by wimey_ctx_save_schema()
+ * ---------------------------------------------
+ * Replaces the registry with the one in `path`, the file is
+ * mapped and used in place: one relocation pass, no allocation
+ * per node. The registry is sealed, it has no value_dest nor
+ * callbacks until they are bound (or values are read in lazy
+ * mode). It stays mapped until wimey_free_all().
+ * Returns: WIMEY_OK or WIMEY_ERR */
+int wimey_ctx_load_schema(struct wimey_ctx *ctx, const char *path) {
+	struct __wimey_mapping map;
+	struct __wimey_snap_header *head;
+	long size;
+
+	wimey_ctx_free_all(ctx);
+	__wimey_error_reset(ctx);
+
+	size = __wimey_file_map(path, &map);
+	if (size < 0) {
+		ERR(ctx, "Failed to read schema %s", path);
+		__wimey_fail(ctx, WIMEY_E_FILE, NULL, path);
+		return WIMEY_ERR;
+	}
+
+	if (!__wimey_snap_relocate(map.addr, size)) {
+		ERR(ctx, "Invalid schema file %s", path);
+		__wimey_fail(ctx, WIMEY_E_FORMAT, NULL, path);
+		munmap(map.addr, map.len);
+		return WIMEY_ERR;
+	}
+
+	head = (struct __wimey_snap_header *)map.addr;
+
+	/* One block for all the setters, one for the hot fields */
+	ctx->dict.setters = __WIMEY_ALLOC(ctx, (head->nargs > 0 ? head->nargs : 1)
+					       * sizeof(__wimey_setter_fn));
+	ctx->dict.hot = __WIMEY_ALLOC(ctx, (head->nargs > 0 ? head->nargs : 1)
+					   * sizeof(struct __wimey_arg_hot));
+	if (ctx->dict.setters == NULL || ctx->dict.hot == NULL) {
+		ERR(ctx, "Failed to allocate schema %s", path);
+		__wimey_fail(ctx, WIMEY_E_NO_MEMORY, NULL, path);
+		munmap(map.addr, map.len);
+		wimey_ctx_free_all(ctx);
+		return WIMEY_ERR;
+	}
+
+	ctx->dict.snapshot = map;
+	ctx->dict.cmds = (struct __wimey_command_node *)(map.addr + head->cmds);
+	ctx->dict.args = (struct __wimey_argument_node *)(map.addr + head->args);
+	ctx->dict.ncmds = ctx->dict.cmds_cap = head->ncmds;
+	ctx->dict.nargs = ctx->dict.args_cap = head->nargs;
+
+	ctx->dict.cmd_slots = (struct __wimey_index_slot *)(map.addr + head->cmd_slots);
+	ctx->dict.arg_slots = (struct __wimey_index_slot *)(map.addr + head->arg_slots);
+	ctx->dict.env_slots = (struct __wimey_index_slot *)(map.addr + head->env_slots);
+	ctx->dict.cmd_mask = head->cmd_size - 1;
+	ctx->dict.arg_mask = head->arg_size - 1;
+	ctx->dict.env_mask = head->env_size - 1;
+	ctx->dict.nenv = head->nenv;
+	memcpy(ctx->dict.shorts, head->shorts, sizeof(ctx->dict.shorts));
+
+	for (size_t i = 0; i < ctx->dict.nargs; i++) {
+		ctx->dict.nlists += __wimey_is_list(ctx->dict.args[i].argument.value_type);
+		ctx->dict.setters[i] = __wimey_setter_of(&ctx->dict.args[i].argument);
+		__wimey_hot_set(&ctx->dict.hot[i], &ctx->dict.args[i]);
+	}
+
+	if (!__wimey_rules_compile(ctx)) {
+		ERR(ctx, "Invalid constraints in schema %s", path);
+		wimey_ctx_free_all(ctx);
+		return WIMEY_ERR;
+	}
+
+	ctx->dict.sealed = true;
+	return WIMEY_OK;
+}
+
+/* Set the destination of the argument with `key` (long or
+ * short), needed after wimey_ctx_load_schema()
+ * Returns: WIMEY_ERR if the key is unknown */
+int wimey_ctx_bind_argument(struct wimey_ctx *ctx, const char *key, void *dest) {
+	struct __wimey_argument_node *node = key != NULL ? __wimey_argument_by_key(ctx, key) : NULL;
+
+	if (node == NULL)
+		return WIMEY_ERR;
+
+	node->argument.value_dest = dest;
+	return WIMEY_OK;
+}
+
+/* Set the parse_fn of a WIMEY_CUSTOM argument, see
+ * wimey_ctx_bind_argument() */
+int wimey_ctx_bind_parser(struct wimey_ctx *ctx, const char *key,
+			  int (*parse_fn)(const char *val, void *dest)) {
+	struct __wimey_argument_node *node = key != NULL ? __wimey_argument_by_key(ctx, key) : NULL;
+
+	if (node == NULL || node->argument.value_type != WIMEY_CUSTOM)
+		return WIMEY_ERR;
+
+	node->argument.parse_fn = parse_fn;
+	return WIMEY_OK;
+}
+
+/* Set the callback of the command at `path` ("remote add") */
+int wimey_ctx_bind_command(struct wimey_ctx *ctx, const char *path,
+			   void (*callback)(const char *value)) {
+	uint32_t level;
+
+	if (!__wimey_resolve_path(ctx, path, &level) || level == 0) {
+		WARN(ctx, "Unknown command %s", path != NULL ? path : "(null)");
+		return WIMEY_ERR;
+	}
+
+	ctx->dict.cmds[level - 1].cmd.callback = callback;
+	return WIMEY_OK;
+}
+
+/* ------- Batch parsing ------- */
+
+/* Allocate the output of wimey_ctx_parse_batch() for `rows` argv
+ * vectors, one column per argument currently registered */
+int wimey_batch_init(struct wimey_ctx *ctx, struct wimey_batch_t *batch,
+		     size_t rows) {
+	size_t cells = rows * ctx->dict.nargs;
+
+	memset(batch, 0, sizeof(*batch));
+	batch->rows = rows;
+	batch->cols = ctx->dict.nargs;
+
+	/* One block: values, then status, then seen flags */
+	batch->values = __WIMEY_ALLOC(ctx, cells * sizeof(union wimey_value_t)
+				      + rows * sizeof(int) + cells + 1);
+	if (batch->values == NULL) {
+		ERR(ctx, "Failed to allocate batch of %zu rows", rows);
+		return WIMEY_ERR;
+	}
+
+	batch->status = (int *)(batch->values + cells);
+	batch->seen = (unsigned char *)(batch->status + rows);
+	return WIMEY_OK;
+}
+
+/* Release a batch allocated by wimey_batch_init() */
+void wimey_batch_free(struct wimey_ctx *ctx, struct wimey_batch_t *batch) {
+	if (batch->values != NULL)
+		__WIMEY_FREE(ctx, batch->values);
+
+	memset(batch, 0, sizeof(*batch));
+}
+
+/* Parse `n` argv vectors against one sealed registry
+ * -------------------------------------------------
+ * Results go to `results` (see wimey_batch_init()) instead of the
+ * value_dest pointers, command callbacks are not called and --help
+ * is a plain flag. The registry is finalized if it isn't yet.
+ * Returns: WIMEY_OK if every row parsed, see results->status */
+int wimey_ctx_parse_batch(struct wimey_ctx *ctx, size_t n, const int *argcs,
+			  char ***argvs, struct wimey_batch_t *results) {
+	if (results == NULL || results->rows < n
+	    || results->cols != ctx->dict.nargs) {
+		ERR(ctx, "Batch output doesn't match the registry");
+		return WIMEY_ERR;
+	}
+
+	if (wimey_ctx_finalize(ctx) != WIMEY_OK)
+		return WIMEY_ERR;
+
+	struct __wimey_schema schema = __wimey_registry_schema(ctx);
+	struct __wimey_sink sink = { .batch = results };
+	int ret = WIMEY_OK;
+
+	memset(results->seen, 0, results->rows * results->cols);
+	__wimey_error_reset(ctx);
+
+	for (size_t row = 0; row < n; row++) {
+		sink.row = row;
+		results->status[row] = __wimey_parse_tokens(&schema, &sink,
+							    argcs[row], argvs[row]);
+		if (results->status[row] != WIMEY_OK)
+			ret = WIMEY_ERR;
+	}
+
+	return ret;
+}
+
+/* Rows claimed at once by a batch worker */
+#define __WIMEY_BATCH_CHUNK 256
+
+struct __wimey_batch_job;
+
+/* A worker parses with its own shallow copy of the context:
+ * the sealed registry is shared and only read, the error
+ * record and the counters are private and merged at the end.
+ * It owns chunks [next, end), other workers steal from it by
+ * claiming from the same atomic counter. */
+struct __wimey_batch_worker {
+	struct wimey_ctx ctx;
+	struct __wimey_batch_job *job;
+	size_t next, end;
+	size_t err_row;	/* first failed row, SIZE_MAX if none */
+	pthread_t thread;
+	bool started;
+};
+
+struct __wimey_batch_job {
+	size_t n;
+	const int *argcs;
+	char ***argvs;
+	struct wimey_batch_t *results;
+	struct __wimey_batch_worker *workers;
+	size_t nworkers;
+};
+
+/* Claim the next chunk of `victim`, false when it has none left */
+static bool __wimey_batch_claim(struct __wimey_batch_worker *victim, size_t *chunk) {
+	if (__atomic_load_n(&victim->next, __ATOMIC_RELAXED) >= victim->end)
+		return false;
+
+	*chunk = __atomic_fetch_add(&victim->next, 1, __ATOMIC_RELAXED);
+	return *chunk < victim->end;
+}
+
+/* Parse the chunks of the worker, then steal the ones left
+ * to the others: every row goes to exactly one worker */
+static void *__wimey_batch_work(void *data) {
+	struct __wimey_batch_worker *self = data;
+	struct __wimey_batch_job *job = self->job;
+	struct __wimey_schema schema = __wimey_registry_schema(&self->ctx);
+	struct __wimey_sink sink = { .batch = job->results };
+	size_t me = self - job->workers;
+
+	for (size_t i = 0; i < job->nworkers; i++) {
+		struct __wimey_batch_worker *victim = &job->workers[(me + i) % job->nworkers];
+		size_t chunk;
+
+		while (__wimey_batch_claim(victim, &chunk)) {
+			size_t row = chunk * __WIMEY_BATCH_CHUNK;
+			size_t end = row + __WIMEY_BATCH_CHUNK < job->n
+				     ? row + __WIMEY_BATCH_CHUNK : job->n;
+
+			for (; row < end; row++) {
+				sink.row = row;
+				job->results->status[row] =
+				    __wimey_parse_tokens(&schema, &sink, job->argcs[row],
+							 job->argvs[row]);
+				if (job->results->status[row] != WIMEY_OK
+				    && row < self->err_row)
+					self->err_row = row;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+#ifdef WIMEY_STATS
+static void __wimey_stats_add(struct wimey_stats_t *dst, const struct wimey_stats_t *src) {
+	dst->parses += src->parses;
+	dst->tokens += src->tokens;
+	dst->key_compares += src->key_compares;
+	dst->conversions += src->conversions;
+	dst->allocations += src->allocations;
+	dst->lookup_cycles += src->lookup_cycles;
+	dst->command_cycles += src->command_cycles;
+	dst->argument_cycles += src->argument_cycles;
+}
+#endif
+
+/* Parse a batch on `nthreads` threads
+ * -----------------------------------
+ * Same output as wimey_ctx_parse_batch(). Rows are split in
+ * chunks among the workers (the calling thread is one of them),
+ * a worker done with its share steals chunks from the others.
+ * Workers only read the sealed registry and write disjoint rows
+ * of `results`, nothing is locked. The log sink, if any, may be
+ * called from every worker at once.
+ * Returns: WIMEY_OK, WIMEY_ERR if any row failed */
+int wimey_ctx_parse_batch_parallel(struct wimey_ctx *ctx, size_t n, const int *argcs,
+				   char ***argvs, struct wimey_batch_t *results,
+				   size_t nthreads) {
+	size_t nchunks = (n + __WIMEY_BATCH_CHUNK - 1) / __WIMEY_BATCH_CHUNK;
+
+	if (nthreads > nchunks)
+		nthreads = nchunks;
+	if (nthreads <= 1)
+		return wimey_ctx_parse_batch(ctx, n, argcs, argvs, results);
+
+	if (results == NULL || results->rows < n
+	    || results->cols != ctx->dict.nargs) {
+		ERR(ctx, "Batch output doesn't match the registry");
+		return WIMEY_ERR;
+	}
+
+	if (wimey_ctx_finalize(ctx) != WIMEY_OK)
+		return WIMEY_ERR;
+
+	struct __wimey_batch_worker *workers =
+		__WIMEY_ALLOC(ctx, nthreads * sizeof(struct __wimey_batch_worker));
+
+	if (workers == NULL) {
+		ERR(ctx, "Failed to allocate %zu batch workers", nthreads);
+		return WIMEY_ERR;
+	}
+
+	struct __wimey_batch_job job = {
+		.n = n,
+		.argcs = argcs,
+		.argvs = argvs,
+		.results = results,
+		.workers = workers,
+		.nworkers = nthreads
+	};
+
+	memset(results->seen, 0, results->rows * results->cols);
+	__wimey_error_reset(ctx);
+
+	for (size_t i = 0; i < nthreads; i++) {
+		struct __wimey_batch_worker *w = &workers[i];
+
+		w->ctx = *ctx;
+		wimey_ctx_reset_stats(&w->ctx);
+		w->job = &job;
+		w->next = nchunks * i / nthreads;
+		w->end = nchunks * (i + 1) / nthreads;
+		w->err_row = SIZE_MAX;
+		w->started = false;
+	}
+
+	/* A worker that fails to start is stolen from */
+	for (size_t i = 1; i < nthreads; i++)
+		workers[i].started = pthread_create(&workers[i].thread, NULL,
+						    __wimey_batch_work, &workers[i]) == 0;
+
+	__wimey_batch_work(&workers[0]);
+
+	size_t err_row = SIZE_MAX;
+
+	for (size_t i = 0; i < nthreads; i++) {
+		struct __wimey_batch_worker *w = &workers[i];
+
+		if (w->started)
+			pthread_join(w->thread, NULL);
+
+		if (w->err_row < err_row) {
+			err_row = w->err_row;
+			ctx->error = w->ctx.error;
+		}
+#ifdef WIMEY_STATS
+		__wimey_stats_add(&ctx->stats, &w->ctx.stats);
+#endif
+	}
+
+	__WIMEY_FREE(ctx, workers);
+	return err_row == SIZE_MAX ? WIMEY_OK : WIMEY_ERR;
+}
+
+/* ------- Streaming ------- */
+
+/* Lines pushed a few bytes at a time (a REPL, a socket): every
+ * byte is looked at once, a token is classified when the byte
+ * after it arrives and handled like in wimey_parse(), so a
+ * command callback runs as soon as its value is complete. Tokens
+ * follow the rules of response files, a newline outside quotes
+ * ends the line. */
+
+#define __WIMEY_STREAM_CHUNK 4096
+
+/* Drop the chunks of the previous line but the newest */
+static void __wimey_stream_recycle(struct wimey_ctx *ctx) {
+	struct __wimey_stream_chunk *head = ctx->stream.chunks;
+
+	if (head == NULL)
+		return;
+
+	for (struct __wimey_stream_chunk *c = head->next, *next; c != NULL; c = next) {
+		next = c->next;
+		__WIMEY_FREE(ctx, c);
+	}
+
+	head->next = NULL;
+	head->used = 0;
+}
+
+static void __wimey_stream_free(struct wimey_ctx *ctx) {
+	__wimey_stream_recycle(ctx);
+	if (ctx->stream.chunks != NULL)
+		__WIMEY_FREE(ctx, ctx->stream.chunks);
+	if (ctx->stream.base != NULL)
+		__WIMEY_FREE(ctx, ctx->stream.base);
+	if (ctx->stream.lazy_base != NULL)
+		__WIMEY_FREE(ctx, ctx->stream.lazy_base);
+
+	memset(&ctx->stream, 0, sizeof(ctx->stream));
+}
+
+/* End of the stream: the tokens of the last line are kept, its
+ * values point into them, until the next begin or free_all() */
+static void __wimey_stream_close(struct wimey_ctx *ctx) {
+	struct __wimey_stream_chunk *chunks = ctx->stream.chunks;
+
+	if (ctx->stream.base != NULL)
+		__WIMEY_FREE(ctx, ctx->stream.base);
+	if (ctx->stream.lazy_base != NULL)
+		__WIMEY_FREE(ctx, ctx->stream.lazy_base);
+
+	memset(&ctx->stream, 0, sizeof(ctx->stream));
+	ctx->stream.chunks = chunks;
+}
+
+/* The current line failed: the rest of it is skipped */
+static void __wimey_stream_fail(struct wimey_ctx *ctx) {
+	if (ctx->error.index < 0)
+		ctx->error.index = ctx->stream.ntok;
+
+	ERR(ctx, "Error during parsing, invalid input");
+	ctx->stream.bad = true;
+	ctx->stream.in_tok = false;
+	ctx->stream.cmd = NULL;
+	ctx->stream.arg = NULL;
+	ctx->stream.failures++;
+}
+
+/* First byte of the first token of a line: what wimey_parse()
+ * does before the tokens, the environment was applied once */
+static void __wimey_stream_line_begin(struct wimey_ctx *ctx) {
+	__wimey_stream_recycle(ctx);
+
+	ctx->stream.in_line = true;
+	ctx->stream.rest = false;
+	ctx->stream.bad = false;
+	ctx->stream.ntok = 0;
+	ctx->stream.level = 0;
+	ctx->str_used = 0;
+	ctx->lists.gen++;
+
+	if (ctx->stream.base != NULL)
+		memcpy(ctx->rules.seen, ctx->stream.base, ctx->rules.words * sizeof(uint64_t));
+	if (ctx->conf.lazy) {
+		if (!__wimey_lazy_begin(ctx))
+			__wimey_stream_fail(ctx);
+		else
+			__wimey_lazy_seed(ctx, ctx->stream.lazy_base,
+					  ctx->stream.lazy_base != NULL ? ctx->dict.nargs : 0);
 	}
+}
 
-	return NULL;
+/* Append a byte to the partial token, a token outgrowing its
+ * chunk moves alone to a new one */
+static void __wimey_stream_put(struct wimey_ctx *ctx, char c) {
+	struct __wimey_stream_chunk *head = ctx->stream.chunks;
+
+	if (ctx->stream.rest || ctx->stream.bad)
+		return;
+
+	if (head == NULL || head->used == head->cap) {
+		size_t part = head != NULL ? head->used - ctx->stream.tok : 0;
+		size_t cap = part * 2 > __WIMEY_STREAM_CHUNK ? part * 2 : __WIMEY_STREAM_CHUNK;
+		struct __wimey_stream_chunk *chunk = __WIMEY_ALLOC(ctx, sizeof(*chunk) + cap);
+
+		if (chunk == NULL) {
+			ERR(ctx, "Failed to allocate stream tokens");
+			__wimey_fail(ctx, WIMEY_E_NO_MEMORY, NULL, NULL);
+			__wimey_stream_fail(ctx);
+			return;
+		}
+
+		chunk->cap = cap;
+		chunk->used = part;
+		chunk->next = head;
+		if (part > 0)
+			memcpy(chunk->data, head->data + ctx->stream.tok, part);
+
+		/* Nothing but the partial token was left in it */
+		if (head != NULL && ctx->stream.tok == 0) {
+			chunk->next = head->next;
+			__WIMEY_FREE(ctx, head);
+		}
+
+		ctx->stream.chunks = head = chunk;
+		ctx->stream.tok = 0;
+	}
+
+	head->data[head->used++] = c;
 }
 
-/* Returns true if string is a registered argument,
- * false if not found in arguments list */
-static bool __wimey_check_argument(char *str) {
-	return __wimey_get_argument_node(str) != NULL;
+static void __wimey_stream_start(struct wimey_ctx *ctx) {
+	if (ctx->stream.in_tok)
+		return;
+	if (!ctx->stream.in_line)
+		__wimey_stream_line_begin(ctx);
+
+	ctx->stream.in_tok = true;
+	ctx->stream.tok = ctx->stream.chunks != NULL ? ctx->stream.chunks->used : 0;
 }
 
-/* Internal function to parse all the arguments,
- * this function also do checks and deref of
- * pointers shared in the arguments  */
-int __wimey_parse_arguments(int argc, char **argv) {
-	if (wimey_get_arguments_head() == NULL)
-		return WIMEY_OK;
+/* Run the command waiting for its value */
+static void __wimey_stream_command(struct wimey_ctx *ctx, char *value) {
+	const struct wimey_command_t *cmd = &ctx->stream.cmd->cmd;
 
-	for (int arg_i = 0; arg_i < argc; arg_i++) {
-		char *current_arg = argv[arg_i];
-		bool is_arg_in_dict = __wimey_check_argument(current_arg);
-		bool overflow = arg_i + 1 > argc;
+	ctx->stream.cmd = NULL;
+	__WIMEY_CYCLES(command_start);
+	__wimey_process_command(ctx, cmd, value);
+	__WIMEY_STAT_CYCLES(ctx, command_cycles, command_start);
+}
 
-		if (!is_arg_in_dict)
-			continue;
+/* A complete token, same rules as __wimey_parse_tokens() with
+ * the lookahead turned around: a command or a key waiting for a
+ * value gets the next token */
+static void __wimey_stream_token(struct wimey_ctx *ctx, char *tok) {
+	struct __wimey_schema schema = __wimey_registry_schema(ctx);
+	struct __wimey_sink sink = { .batch = NULL, .lazy = ctx->conf.lazy, .stream = true };
+	const struct wimey_argument_t *arg = ctx->stream.arg;
+	const void *entry;
+	char *inline_val;
+	enum __wimey_token_kind kind;
+
+	ctx->stream.ntok++;
+	__WIMEY_STAT(ctx, tokens, 1);
+
+	/* The value of a key is the next token, whatever it looks like */
+	if (arg != NULL) {
+		ctx->stream.arg = NULL;
+		if (strcmp(tok, "--") == 0) {
+			ERR(ctx, "Argument %s requires value `%s` but none provided",
+			    arg->long_key, arg->value_name);
+			__wimey_fail(ctx, WIMEY_E_MISSING_VALUE, arg->long_key, NULL);
+			goto err;
+		}
+		if (!__wimey_take_argument(&schema, &sink, arg, tok, 1, ctx->stream.argv0))
+			goto err;
+		return;
+	}
 
-		struct __wimey_argument_node *node =
-		    __wimey_get_argument_node(current_arg);
-
-		if (node->argument.is_value_required 
-				&& node->argument.value_type != WIMEY_BOOL 
-				&& overflow) {
-			
-			ERR("Argument %s requires value `%s` but none provided",
-			    node->argument.long_key, node->argument.value_name);
+	__WIMEY_CYCLES(lookup_start);
+	kind = __wimey_classify_token(&schema, ctx->stream.level, tok, &entry, &inline_val);
+	__WIMEY_STAT_CYCLES(ctx, lookup_cycles, lookup_start);
+
+	/* The value of a command only if it isn't a key itself */
+	if (ctx->stream.cmd != NULL) {
+		bool is_value = kind == __WIMEY_TOK_VALUE;
+
+		__wimey_stream_command(ctx, is_value ? tok : NULL);
+		if (is_value)
+			return;
+	}
+
+	switch (kind) {
+	case __WIMEY_TOK_END:
+		ctx->stream.rest = true;
+		return;
+
+	case __WIMEY_TOK_VALUE:
+		__wimey_warn_unknown(&schema, &sink, tok);
+		return;
+
+	case __WIMEY_TOK_COMMAND: {
+		const struct __wimey_command_node *node = entry;
+
+		ctx->stream.level = node - ctx->dict.cmds + 1;
+		ctx->stream.cmd = node;
+		if (!node->cmd.has_value)
+			__wimey_stream_command(ctx, NULL);
+		return;
+	}
+
+	case __WIMEY_TOK_LONG:
+	case __WIMEY_TOK_SHORT:
+		arg = entry;
+		if (inline_val != NULL && __wimey_is_flag(arg)) {
+			ERR(ctx, "Argument %s doesn't take a value", arg->long_key);
+			__wimey_fail(ctx, WIMEY_E_UNEXPECTED_VALUE, arg->long_key, inline_val);
 			goto err;
 		}
-		
-		if (node->argument.has_value && !overflow) {
 
-			if(strcmp(node->argument.long_key, help_arg.long_key) == 0) {
-				__wimey_print_help(argc, argv);
-				exit(EXIT_SUCCESS);
+		if (inline_val == NULL && !__wimey_is_flag(arg)) {
+			ctx->stream.arg = arg;
+			return;
+		}
 
-				return WIMEY_OK; /* Program will never reach this code  */
-			}
-			char *val = argv[arg_i + 1];
-			
-			/* Here we check the type of the argument */
-			switch (node->argument.value_type) {
-			case WIMEY_LONG:
-				long res_l = wimey_val_to_long(val);
-				*(long *)node->argument.value_dest = res_l;
-				break;
-			case WIMEY_DOUBLE:
-				double res_d = wimey_val_to_double(val);
-				*(double *)node->argument.value_dest = res_d;
-				break;
-			case WIMEY_STR:
-				*(char **)node->argument.value_dest =
-				    strdup(val);
-				break;
-			case WIMEY_BOOL:
-				*(int *)node->argument.value_dest = true;
-				break;
-			default:
-				ERR("Failed to resolve argument type");
+		if (!__wimey_take_argument(&schema, &sink, arg, inline_val, 1, ctx->stream.argv0))
+			goto err;
+		return;
+
+	case __WIMEY_TOK_BUNDLE:
+		arg = entry;
+		for (char *p = tok + 1; *p != '\0'; p++) {
+			if (arg == NULL)
+				arg = __wimey_schema_find_short(&schema, ctx->stream.level, *p);
+			if (arg == NULL) {
+				const char *hint = __wimey_suggest(&schema, false, tok, strlen(tok));
+
+				if (hint != NULL)
+					ERR(ctx, "Unknown flag -%c in %s, did you mean %s?",
+					    *p, tok, hint);
+				else
+					ERR(ctx, "Unknown flag -%c in %s", *p, tok);
+				__wimey_fail(ctx, WIMEY_E_UNKNOWN_KEY, NULL, tok);
 				goto err;
 			}
-			continue;
+
+			/* A key with a value ends the bundle */
+			if (!__wimey_is_flag(arg) && p[1] == '\0') {
+				ctx->stream.arg = arg;
+				return;
+			}
+
+			char *val = __wimey_is_flag(arg) ? NULL : p + 1;
+
+			if (!__wimey_take_argument(&schema, &sink, arg, val, 1, ctx->stream.argv0))
+				goto err;
+			if (val != NULL)
+				return;
+			arg = NULL;
 		}
+		return;
 	}
 
-	return WIMEY_OK;
+	return;
 
 err:
-	ERR("Error during argument parsing, invalid input");
-	return WIMEY_ERR;
+	__wimey_stream_fail(ctx);
 }
 
-/* --------------- Utility functions ---------------- */
+/* End of the partial token, if any */
+static void __wimey_stream_finish(struct wimey_ctx *ctx) {
+	if (!ctx->stream.in_tok)
+		return;
 
-/* This function simply create a privilaged node
- * that contains the help argument  */
-int wimey_generate_help() {
-	if(wimey_add_argument(help_arg) != WIMEY_OK) {
-		ERR("Error during `--help` generation");
+	ctx->stream.in_tok = false;
+	__wimey_stream_put(ctx, '\0');
+	if (ctx->stream.rest || ctx->stream.bad)
+		return;
+
+	__wimey_stream_token(ctx, ctx->stream.chunks->data + ctx->stream.tok);
+}
+
+/* End of a line: what waits for a value gets none, then the
+ * constraints. Blank lines cost nothing. */
+static void __wimey_stream_line_end(struct wimey_ctx *ctx) {
+	__wimey_stream_finish(ctx);
+
+	if (!ctx->stream.in_line)
+		return;
+	ctx->stream.in_line = false;
+	if (ctx->stream.bad)
+		return;
+
+	const struct wimey_argument_t *arg = ctx->stream.arg;
+
+	if (arg != NULL) {
+		ERR(ctx, "Argument %s requires value `%s` but none provided",
+		    arg->long_key, arg->value_name);
+		__wimey_fail(ctx, WIMEY_E_MISSING_VALUE, arg->long_key, NULL);
+		goto err;
+	}
+
+	if (ctx->stream.cmd != NULL) {
+		const struct wimey_command_t *cmd = &ctx->stream.cmd->cmd;
+
+		if (cmd->is_value_required) {
+			ERR(ctx, "Command %s requires value `%s` but none provided",
+			    cmd->key, cmd->value_name);
+			__wimey_fail(ctx, WIMEY_E_MISSING_VALUE, cmd->key, NULL);
+			goto err;
+		}
+		__wimey_stream_command(ctx, NULL);
+	}
+
+	if (!__wimey_rules_check(ctx, ctx->stream.level))
+		goto err;
+	return;
+
+err:
+	ctx->stream.ntok = -1;
+	__wimey_stream_fail(ctx);
+}
+
+/* Start a stream
+ * --------------
+ * Parses the lines given to wimey_ctx_stream_feed() with the
+ * registry, which must not change until wimey_ctx_stream_end().
+ * The environment is applied once, here. Each line is like one
+ * wimey_parse() (response files are not expanded), --help
+ * prints the help without exiting.
+ * Returns: WIMEY_OK or WIMEY_ERR */
+int wimey_ctx_stream_begin(struct wimey_ctx *ctx) {
+	__wimey_stream_free(ctx);
+	__wimey_error_reset(ctx);
+
+	if (ctx->conf.lazy) {
+		if (!__wimey_lazy_begin(ctx))
+			return WIMEY_ERR;
+		__wimey_lazy_seed(ctx, ctx->lazy.preset, ctx->lazy.preset_cap);
+	}
+
+	if (!__wimey_rules_begin(ctx) || !__wimey_apply_env(ctx))
 		return WIMEY_ERR;
+
+	/* The config file and environment values start every line */
+	if (ctx->conf.lazy && ctx->dict.nargs > 0) {
+		size_t size = ctx->dict.nargs * sizeof(struct __wimey_lazy_slot);
+
+		ctx->stream.lazy_base = __WIMEY_ALLOC(ctx, size);
+		if (ctx->stream.lazy_base == NULL) {
+			ERR(ctx, "Failed to allocate the stream");
+			__wimey_fail(ctx, WIMEY_E_NO_MEMORY, NULL, NULL);
+			return WIMEY_ERR;
+		}
+
+		for (size_t i = 0; i < ctx->dict.nargs; i++) {
+			ctx->stream.lazy_base[i] = ctx->lazy.slots[i];
+			if (ctx->lazy.slots[i].gen != ctx->lazy.gen)
+				ctx->stream.lazy_base[i].gen = 0;
+		}
 	}
-	
+
+	/* The marks of the environment start every line */
+	if (ctx->rules.seen != NULL) {
+		size_t size = ctx->rules.words * sizeof(uint64_t);
+
+		ctx->stream.base = __WIMEY_ALLOC(ctx, size);
+		if (ctx->stream.base == NULL) {
+			ERR(ctx, "Failed to allocate the stream");
+			__wimey_fail(ctx, WIMEY_E_NO_MEMORY, NULL, NULL);
+			return WIMEY_ERR;
+		}
+		memcpy(ctx->stream.base, ctx->rules.seen, size);
+	}
+
+	ctx->stream.argv0[0] = ctx->conf.name[0] != '\0' ? ctx->conf.name : "program";
+	ctx->stream.active = true;
 	return WIMEY_OK;
 }
 
-/* Internal helper to print the help
- * list and the program informations  */
-void __wimey_print_help(int argc, char **argv) {
-	(void)argc;
+/* Feed bytes to the stream
+ * ------------------------
+ * `bytes` may end anywhere, in a token or in quotes. Values of
+ * WIMEY_STR_BORROW strings and lazy reads point into the stream,
+ * they stay valid until the next line starts. A failing line is
+ * skipped up to its end, the next ones are still parsed.
+ * Returns: WIMEY_ERR if a line ended in this feed failed, the
+ * first failure is in wimey_ctx_get_error() (`index` is the
+ * token of the line, from 1, or -1 at its end) */
+int wimey_ctx_stream_feed(struct wimey_ctx *ctx, const char *bytes, size_t len) {
+	size_t failures = ctx->stream.failures;
+
+	if (!ctx->stream.active) {
+		ERR(ctx, "Stream not started, see wimey_stream_begin()");
+		return WIMEY_ERR;
+	}
 
-	struct __wimey_argument_node *arg = wimey_get_arguments_head();
-	struct __wimey_command_node *cmd = wimey_get_commands_head();
-	
-	if(wimey_conf.name[0] != '\0' && wimey_conf.version != NULL)
-		printf("%s (v%s)", wimey_conf.name, wimey_conf.version);
-	
-	if(wimey_conf.usage == NULL) {
-		printf("\n%s [options] [arguments]", argv[0]);
-	} else {
-		printf("\nUsage: %s\n", wimey_conf.usage);
+	__wimey_error_reset(ctx);
+	for (size_t i = 0; i < len; i++) {
+		char c = bytes[i];
+
+		if (ctx->stream.escape) {
+			ctx->stream.escape = false;
+
+			/* In "..." only \" and \\ are escapes */
+			if (ctx->stream.quote != '"' || c == '"' || c == '\\') {
+				__wimey_stream_put(ctx, c);
+				continue;
+			}
+			__wimey_stream_put(ctx, '\\');
+		}
+
+		if (ctx->stream.quote != '\0') {
+			if (c == ctx->stream.quote)
+				ctx->stream.quote = '\0';
+			else if (c == '\\' && ctx->stream.quote == '"')
+				ctx->stream.escape = true;
+			else
+				__wimey_stream_put(ctx, c);
+			continue;
+		}
+
+		if (c == '\n') {
+			__wimey_stream_line_end(ctx);
+		} else if (__wimey_is_space(c)) {
+			__wimey_stream_finish(ctx);
+		} else {
+			__wimey_stream_start(ctx);
+			if (c == '\'' || c == '"')
+				ctx->stream.quote = c;
+			else if (c == '\\')
+				ctx->stream.escape = true;
+			else
+				__wimey_stream_put(ctx, c);
+		}
 	}
-	
-	if(wimey_conf.description != NULL)
-		printf("\n%s\n", wimey_conf.description);
-	
-	/* We need to take the max command key len */
-	int max_cmd_len = 0;
-    	while (cmd != NULL) {
-        	int len = strlen(cmd->cmd.key);
-        	if (len > max_cmd_len) max_cmd_len = len;
-		cmd = cmd->next;
-    	}
 
-	int max_arg_len = 0;
-	while(arg != NULL) {
-		int alen = strlen(arg->argument.long_key) /* Adding len for --help  */
-			+ strlen(arg->argument.short_key)  /* Adding len for -h */
-			+ 2; /* Adding len for the 2 spaces between --help and -h */
-		if(alen > max_arg_len) max_arg_len = alen;
-		arg = arg->next;
+	return ctx->stream.failures == failures ? WIMEY_OK : WIMEY_ERR;
+}
+
+/* End a stream
+ * ------------
+ * The last line ends even without its newline, then what the
+ * stream allocated is released but the tokens of that line: its
+ * borrowed values stay valid until the next wimey_ctx_stream_begin()
+ * or wimey_ctx_free_all().
+ * Returns: WIMEY_ERR if that line failed */
+int wimey_ctx_stream_end(struct wimey_ctx *ctx) {
+	size_t failures = ctx->stream.failures;
+
+	if (!ctx->stream.active)
+		return WIMEY_ERR;
+
+	__wimey_error_reset(ctx);
+	if (ctx->stream.escape)
+		__wimey_stream_put(ctx, '\\');
+
+	if (ctx->stream.quote != '\0' && !ctx->stream.bad) {
+		ERR(ctx, "Unterminated quote at the end of the stream");
+		__wimey_fail(ctx, WIMEY_E_INVALID_VALUE, NULL, NULL);
+		ctx->stream.ntok = -1;
+		__wimey_stream_fail(ctx);
 	}
-	
-	int max_len = max_cmd_len > max_arg_len ? max_cmd_len : max_arg_len;
 
-	cmd = wimey_get_commands_head();
-	arg = wimey_get_arguments_head();
+	__wimey_stream_line_end(ctx);
+
+	int ret = ctx->stream.failures == failures ? WIMEY_OK : WIMEY_ERR;
+
+	__wimey_stream_close(ctx);
+	return ret;
+}
+
+/* ------- Static tables ------- */
+
+/* Parse argv against static tables, nothing is registered,
+ * only the configuration of `ctx` is used */
+int wimey_ctx_parse_table(struct wimey_ctx *ctx,
+			  const struct wimey_argument_t *args, size_t n,
+			  const struct wimey_command_t *cmds, size_t m,
+			  int argc, char **argv) {
+	return wimey_ctx_parse_table_indexed(ctx, args, n, cmds, m, NULL,
+					     argc, argv);
+}
+
+/* Parse argv against static tables resolving keys through
+ * an index made by wimey_table_write_index() */
+int wimey_ctx_parse_table_indexed(struct wimey_ctx *ctx,
+				  const struct wimey_argument_t *args, size_t n,
+				  const struct wimey_command_t *cmds, size_t m,
+				  const struct wimey_table_index_t *index,
+				  int argc, char **argv) {
+	struct __wimey_schema schema = {
+		.ctx = ctx,
+		.is_table = true,
+		.cmds = cmds,
+		.args = args,
+		.ncmds = cmds != NULL ? m : 0,
+		.nargs = args != NULL ? n : 0,
+		.index = index
+	};
+	struct __wimey_sink sink = { .batch = NULL };
+
+	ctx->str_used = 0;
+	__wimey_error_reset(ctx);
+	if (ctx->conf.response_files && !__wimey_argfiles_expand(ctx, &argc, &argv))
+		return WIMEY_ERR;
+
+	return __wimey_parse_tokens(&schema, &sink, argc, argv);
+}
+
+/* Write one slots array of a generated index */
+static void __wimey_write_slots(FILE *out, const char *name, const char *kind,
+				const uint32_t *slots, size_t size) {
+	fprintf(out, "static const uint32_t %s_%s_slots[%zu] = {", name, kind, size);
+
+	for (size_t i = 0; i < size; i++)
+		fprintf(out, "%s%s%u", i ? "," : "", i % 16 ? " " : "\n\t", slots[i]);
+
+	fprintf(out, "\n};\n\n");
+}
+
+/* Insert a table position in a generated index */
+static void __wimey_table_insert(uint32_t *slots, size_t mask, const char *key,
+				 uint32_t pos) {
+	if (key == NULL)
+		return;
+
+	size_t i = __wimey_hash(key) & mask;
+
+	while (slots[i] != 0)
+		i = (i + 1) & mask;
 
-	printf("\n%s\n", "Commands:");
-	while(cmd != NULL) {
-		printf("  %-*s  %s\n", max_len, cmd->cmd.key, cmd->cmd.desc);
-		cmd = cmd->next;
+	slots[i] = pos + 1;
+}
+
+/* Generate the C source of a precomputed index for static tables
+ * ------------------------------------------------------------
+ * Writes `static const struct wimey_table_index_t <name>` to `out`,
+ * the output is meant to be saved in a source file (for example by
+ * a small generator run from the build) and passed to
+ * wimey_parse_table_indexed(), so the index lives in .rodata.
+ * Returns: WIMEY_OK or WIMEY_ERR on allocation failure */
+int wimey_table_write_index(FILE *out, const char *name,
+			    const struct wimey_argument_t *args, size_t n,
+			    const struct wimey_command_t *cmds, size_t m) {
+	size_t cmd_size = __wimey_index_size(m);
+	size_t arg_size = __wimey_index_size(n * 2);
+	uint32_t *cmd_slots = calloc(cmd_size, sizeof(uint32_t));
+	uint32_t *arg_slots = calloc(arg_size, sizeof(uint32_t));
+
+	if (out == NULL || name == NULL || !cmd_slots || !arg_slots) {
+		ERR(&wimey_default_ctx, "Failed to generate table index");
+		free(cmd_slots);
+		free(arg_slots);
+		return WIMEY_ERR;
+	}
+
+	/* Only the first entry of a duplicated key is reachable,
+	 * same as the linear lookup */
+	for (size_t i = 0; i < m; i++) {
+		struct __wimey_schema schema = { .is_table = true, .cmds = cmds, .ncmds = i };
+
+		if (__wimey_schema_find_command(&schema, 0, cmds[i].key) == NULL)
+			__wimey_table_insert(cmd_slots, cmd_size - 1, cmds[i].key, i);
 	}
 
-	printf("\n%s\n", "Arguments: ");
-	while(arg != NULL) {
-		char buffer[256];
-		snprintf(buffer, sizeof(buffer), "%s  %s", arg->argument.short_key, arg->argument.long_key);	
-		printf("  %-*s  %s\n", max_len, buffer, arg->argument.desc);
-		arg = arg->next;
+	for (size_t i = 0; i < n; i++) {
+		struct __wimey_schema schema = { .is_table = true, .args = args, .nargs = i };
+
+		if (args[i].long_key != NULL
+		    && !__wimey_schema_find_argument(&schema, 0, args[i].long_key))
+			__wimey_table_insert(arg_slots, arg_size - 1, args[i].long_key, i);
+		if (args[i].short_key != NULL
+		    && !__wimey_schema_find_argument(&schema, 0, args[i].short_key))
+			__wimey_table_insert(arg_slots, arg_size - 1, args[i].short_key, i);
 	}
-	
-	if(wimey_conf.copyright != NULL)
-		printf("\n%s\n", wimey_conf.copyright);
 
-	if(wimey_conf.license != NULL)
-		printf("This software is under %s license.", wimey_conf.license);
+	fprintf(out, "/* Generated by wimey_table_write_index(), do not edit */\n");
+	__wimey_write_slots(out, name, "cmd", cmd_slots, cmd_size);
+	__wimey_write_slots(out, name, "arg", arg_slots, arg_size);
+	fprintf(out, "static const struct wimey_table_index_t %s = {\n"
+		"\t.cmd_slots = %s_cmd_slots,\n\t.cmd_size = %zu,\n"
+		"\t.arg_slots = %s_arg_slots,\n\t.arg_size = %zu\n};\n",
+		name, name, cmd_size, name, arg_size);
+
+	free(cmd_slots);
+	free(arg_slots);
+	return WIMEY_OK;
 }
 
-/* Generic string to long converter that can be used
- * for different integer subtypes (uint16_t, int32_t etc) */
-long wimey_val_to_long(const char *val) {
-	long res;
-	char *p_end;
+/* Free all allocated memory for commands and arguments,
+ * the registry is made of a few arrays so this is a
+ * constant number of releases */
+void wimey_ctx_free_all(struct wimey_ctx *ctx) {
+	/* Nodes and index of a loaded schema live in the mapping */
+	if (ctx->dict.snapshot.addr != NULL) {
+		munmap(ctx->dict.snapshot.addr, ctx->dict.snapshot.len);
+		ctx->dict.snapshot.addr = NULL;
+		ctx->dict.snapshot.len = 0;
+		ctx->dict.cmds = NULL;
+		ctx->dict.args = NULL;
+		ctx->dict.cmd_slots = NULL;
+		ctx->dict.arg_slots = NULL;
+		ctx->dict.env_slots = NULL;
+	}
 
-	if (val == NULL || !val)
-		goto err;
+	if (ctx->dict.cmds != NULL)
+		__WIMEY_FREE(ctx, ctx->dict.cmds);
+	if (ctx->dict.args != NULL)
+		__WIMEY_FREE(ctx, ctx->dict.args);
+
+	if (ctx->dict.arg_keys != NULL)
+		__WIMEY_FREE(ctx, ctx->dict.arg_keys);
+	if (ctx->dict.setters != NULL)
+		__WIMEY_FREE(ctx, ctx->dict.setters);
+	if (ctx->dict.hot != NULL)
+		__WIMEY_FREE(ctx, ctx->dict.hot);
+
+	ctx->dict.cmds = NULL;
+	ctx->dict.args = NULL;
+	ctx->dict.arg_keys = NULL;
+	ctx->dict.setters = NULL;
+	ctx->dict.hot = NULL;
+	ctx->dict.ncmds = ctx->dict.cmds_cap = 0;
+	ctx->dict.nargs = ctx->dict.args_cap = 0;
+	ctx->dict.keys_cap = 0;
+
+	__wimey_index_free(ctx);
+	__wimey_help_free(ctx);
+	__wimey_lists_free(ctx);
+	ctx->dict.nlists = 0;
+	__wimey_delta_free(ctx);
+	__wimey_stream_free(ctx);
+	__wimey_rules_free(ctx);
+
+	if (ctx->rules.preset != NULL)
+		__WIMEY_FREE(ctx, ctx->rules.preset);
+
+	ctx->rules.preset = NULL;
+	ctx->rules.preset_words = 0;
+
+	if (ctx->lazy.slots != NULL)
+		__WIMEY_FREE(ctx, ctx->lazy.slots);
+	if (ctx->lazy.preset != NULL)
+		__WIMEY_FREE(ctx, ctx->lazy.preset);
+
+	ctx->lazy.slots = NULL;
+	ctx->lazy.cap = 0;
+	ctx->lazy.gen = 0;
+	ctx->lazy.preset = NULL;
+	ctx->lazy.preset_cap = 0;
+
+	__wimey_argfiles_release(ctx);
+	if (ctx->argfiles.maps != NULL)
+		__WIMEY_FREE(ctx, ctx->argfiles.maps);
+	if (ctx->argfiles.argv != NULL)
+		__WIMEY_FREE(ctx, ctx->argfiles.argv);
+
+	ctx->argfiles.maps = NULL;
+	ctx->argfiles.argv = NULL;
+	ctx->argfiles.maps_cap = 0;
+	ctx->argfiles.argv_cap = 0;
+
+	__wimey_configs_unmap(ctx, 0);
+	if (ctx->configs.maps != NULL)
+		__WIMEY_FREE(ctx, ctx->configs.maps);
+
+	ctx->configs.maps = NULL;
+	ctx->configs.maps_cap = 0;
+}
 
-	errno = 0;
-	res = strtol(val, &p_end, 10);
+/* Allocate a new context with the default configuration
+ * ----------------------------------------------------
+ * Each context owns its registry and configuration, contexts
+ * share nothing so they can be used from different threads.
+ * Returns: the context or NULL on allocation failure */
+struct wimey_ctx *wimey_ctx_new(void) {
+	struct wimey_ctx init = __WIMEY_CTX_INITIALIZER;
+	struct wimey_ctx *ctx = malloc(sizeof(*ctx));
+
+	if (ctx == NULL) {
+		ERR(&wimey_default_ctx, "Failed to allocate context");
+		return NULL;
+	}
 
-	if (errno == ERANGE || *p_end != '\0')
-		goto err;
+	*ctx = init;
+	return ctx;
+}
 
-	return res;
+/* Release everything owned by a context and the context itself */
+void wimey_ctx_free(struct wimey_ctx *ctx) {
+	if (ctx == NULL)
+		return;
 
-err:
-	ERR("Conversion failed, check input: %s", val);
-	return WIMEY_ERR;
+	wimey_ctx_free_all(ctx);
+	free(ctx);
 }
 
-/* Convert command/argument value to int */
-int wimey_val_to_int(const char *val) {
-	return (int)wimey_val_to_long(val);
+/* ------- Default context ------- */
+
+/* The original API is a thin wrapper over wimey_default_ctx */
+
+struct wimey_ctx *wimey_get_default_ctx(void) {
+	return &wimey_default_ctx;
 }
 
-/* Convert command/argument value to float using strtof() */
-float wimey_val_to_float(const char *val) {
-	float res;
-	char *p_end;
+int wimey_init(void) {
+	return wimey_ctx_init(&wimey_default_ctx);
+}
 
-	if (val == NULL || !val)
-		goto err;
+int wimey_init_with_capacity(size_t ncmds, size_t nargs) {
+	return wimey_ctx_init_with_capacity(&wimey_default_ctx, ncmds, nargs);
+}
 
-	res = strtof(val, &p_end);
+int wimey_set_allocator(const struct wimey_allocator_t *allocator) {
+	return wimey_ctx_set_allocator(&wimey_default_ctx, allocator);
+}
 
-	if (p_end == val)
-		goto err;
+int wimey_set_config(struct wimey_config_t *conf) {
+	return wimey_ctx_set_config(&wimey_default_ctx, conf);
+}
 
-	return res;
+struct wimey_config_t wimey_get_config(void) {
+	return wimey_ctx_get_config(&wimey_default_ctx);
+}
 
-err:
-	ERR("Conversion failed, check input: %s", val);
-	return WIMEY_ERR;
+void wimey_set_log_sink(wimey_log_fn fn, void *user) {
+	wimey_ctx_set_log_sink(&wimey_default_ctx, fn, user);
 }
 
-/* Convert command/argument value to double using strtod() */
-double wimey_val_to_double(const char *val) {
-	double res;
-	char *p_end;
+const struct wimey_error_t *wimey_get_error(void) {
+	return wimey_ctx_get_error(&wimey_default_ctx);
+}
 
-	if (val == NULL || !val)
-		goto err;
+const uint64_t *wimey_reparse_delta(int argc, char **argv) {
+	return wimey_ctx_reparse_delta(&wimey_default_ctx, argc, argv);
+}
 
-	res = strtod(val, &p_end);
+size_t wimey_serialize_results(void *buf, size_t len) {
+	return wimey_ctx_serialize_results(&wimey_default_ctx, buf, len);
+}
 
-	if (p_end == val)
-		goto err;
+int wimey_deserialize_results(const void *buf, size_t len) {
+	return wimey_ctx_deserialize_results(&wimey_default_ctx, buf, len);
+}
 
-	return res;
+int wimey_save_schema(const char *path) {
+	return wimey_ctx_save_schema(&wimey_default_ctx, path);
+}
 
-err:
-	ERR("Conversion failed, check input: %s", val);
-	return WIMEY_ERR;
+int wimey_load_schema(const char *path) {
+	return wimey_ctx_load_schema(&wimey_default_ctx, path);
 }
 
-/* Convert string to unsigned long long */
-uint64_t wimey_val_to_u64(const char *val) {
-	long res;
-	char *p_end;
+int wimey_bind_argument(const char *key, void *dest) {
+	return wimey_ctx_bind_argument(&wimey_default_ctx, key, dest);
+}
 
-	if (val == NULL || !val)
-		goto err;
+int wimey_bind_parser(const char *key, int (*parse_fn)(const char *val, void *dest)) {
+	return wimey_ctx_bind_parser(&wimey_default_ctx, key, parse_fn);
+}
 
-	errno = 0;
+int wimey_bind_command(const char *path, void (*callback)(const char *value)) {
+	return wimey_ctx_bind_command(&wimey_default_ctx, path, callback);
+}
 
-	/* Uses strtoll() from stdlib.h to convert strings
-	 * to uint64_t (unsigned long long) */
-	res = strtoll(val, &p_end, 10);
+int wimey_stream_begin(void) {
+	return wimey_ctx_stream_begin(&wimey_default_ctx);
+}
 
-	if (errno == ERANGE || *p_end != '\0')
-		goto err;
+int wimey_stream_feed(const char *bytes, size_t len) {
+	return wimey_ctx_stream_feed(&wimey_default_ctx, bytes, len);
+}
 
-	return res;
+int wimey_stream_end(void) {
+	return wimey_ctx_stream_end(&wimey_default_ctx);
+}
 
-err:
-	ERR("Conversion failed, check input: %s", val);
-	return WIMEY_ERR;
+void wimey_free_all(void) {
+	wimey_ctx_free_all(&wimey_default_ctx);
 }
 
-/* Basic cast of wimey_val_to_long to return char */
-char wimey_val_to_char(const char *val) {
-	return (char)wimey_val_to_long(val);
+struct wimey_stats_t wimey_get_stats(void) {
+	return wimey_ctx_get_stats(&wimey_default_ctx);
 }
 
-/* Initialize library with default configuration */
-int wimey_init(void) {
-	wimey_dict.cmds_head = NULL;
-	wimey_dict.args_head = NULL;
-	return WIMEY_OK;
+void wimey_reset_stats(void) {
+	wimey_ctx_reset_stats(&wimey_default_ctx);
+}
+
+size_t wimey_complete(int argc, char **argv, const char **out, size_t max) {
+	return wimey_ctx_complete(&wimey_default_ctx, argc, argv, out, max);
+}
+
+int wimey_complete_main(int argc, char **argv) {
+	return wimey_ctx_complete_main(&wimey_default_ctx, argc, argv);
+}
+
+int wimey_load_config_file(const char *path) {
+	return wimey_ctx_load_config_file(&wimey_default_ctx, path);
+}
+
+void wimey_release_config_files(void) {
+	wimey_ctx_release_config_files(&wimey_default_ctx);
+}
+
+int wimey_is_set(const char *key) {
+	return wimey_ctx_is_set(&wimey_default_ctx, key);
+}
+
+long wimey_get_long(const char *key) {
+	return wimey_ctx_get_long(&wimey_default_ctx, key);
+}
+
+double wimey_get_double(const char *key) {
+	return wimey_ctx_get_double(&wimey_default_ctx, key);
+}
+
+const char *wimey_get_str(const char *key) {
+	return wimey_ctx_get_str(&wimey_default_ctx, key);
+}
+
+int wimey_get_bool(const char *key) {
+	return wimey_ctx_get_bool(&wimey_default_ctx, key);
+}
+
+size_t wimey_render_help(char *buf, size_t len) {
+	return wimey_ctx_render_help(&wimey_default_ctx, buf, len);
+}
+
+int wimey_finalize(void) {
+	return wimey_ctx_finalize(&wimey_default_ctx);
 }
 
-/* Wrapper for internal parsing functions */
 int wimey_parse(int argc, char **argv) {
-	int cmds_parse = __wimey_parse_commands(argc, argv);
-	int args_parse = __wimey_parse_arguments(argc, argv);
+	return wimey_ctx_parse(&wimey_default_ctx, argc, argv);
+}
 
-	return cmds_parse && args_parse;
+int wimey_parse_table(const struct wimey_argument_t *args, size_t n,
+		      const struct wimey_command_t *cmds, size_t m,
+		      int argc, char **argv) {
+	return wimey_ctx_parse_table(&wimey_default_ctx, args, n, cmds, m,
+				     argc, argv);
 }
 
-/* Free all allocated memory for commands and arguments */
-void wimey_free_all(void) {
-	struct __wimey_command_node *current_cmd = wimey_dict.cmds_head;
-	struct __wimey_argument_node *current_arg = wimey_dict.args_head;
+int wimey_parse_table_indexed(const struct wimey_argument_t *args, size_t n,
+			      const struct wimey_command_t *cmds, size_t m,
+			      const struct wimey_table_index_t *index,
+			      int argc, char **argv) {
+	return wimey_ctx_parse_table_indexed(&wimey_default_ctx, args, n,
+					     cmds, m, index, argc, argv);
+}
 
-	struct __wimey_command_node *tmp_cmd;
-	struct __wimey_argument_node *tmp_arg;
+int wimey_add_command(struct wimey_command_t cmd) {
+	return wimey_ctx_add_command(&wimey_default_ctx, cmd);
+}
 
-	/* Free commands list */
-	while (current_cmd != NULL) {
-		tmp_cmd = current_cmd->next;
+struct __wimey_command_node *wimey_get_commands_head(void) {
+	return wimey_ctx_get_commands_head(&wimey_default_ctx);
+}
 
-		free(current_cmd);
-		current_cmd = tmp_cmd;
-	}
+int wimey_add_argument(struct wimey_argument_t argument) {
+	return wimey_ctx_add_argument(&wimey_default_ctx, argument);
+}
 
-	wimey_dict.cmds_head = NULL;
+struct __wimey_argument_node *wimey_get_arguments_head(void) {
+	return wimey_ctx_get_arguments_head(&wimey_default_ctx);
+}
 
-	/* Free arguments list */
-	while (current_arg != NULL) {
-		tmp_arg = current_arg->next;
+int wimey_generate_help() {
+	return wimey_ctx_generate_help(&wimey_default_ctx);
+}
 
-		free(current_arg);
-		current_arg = tmp_arg;
-	}
+int wimey_parse_batch_parallel(size_t n, const int *argcs, char ***argvs,
+			       struct wimey_batch_t *results, size_t nthreads) {
+	return wimey_ctx_parse_batch_parallel(&wimey_default_ctx, n, argcs, argvs,
+					      results, nthreads);
+}
 
-	wimey_dict.args_head = NULL;
+int wimey_parse_batch(size_t n, const int *argcs, char ***argvs,
+		      struct wimey_batch_t *results) {
+	return wimey_ctx_parse_batch(&wimey_default_ctx, n, argcs, argvs, results);
 }
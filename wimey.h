@@ -23,7 +23,9 @@
 extern "C" {
 #endif
 
+#include <stdio.h>
 #include <stdint.h>
+#include <stddef.h>
 
 #define WIMEY_OK 1
 #define WIMEY_ERR 0
@@ -57,6 +59,16 @@ extern "C" {
 		printf(GREEN "INFO  " RESET msg "\n", ##__VA_ARGS__); \
 	} while (0)
 
+/* WIMEY_STR storage mode (wimey_config_t.str_mode):
+ * WIMEY_STR_DUP    - strdup() every value, caller frees it (default)
+ * WIMEY_STR_BORROW - store pointers straight into argv, no allocation
+ * WIMEY_STR_BUFFER - copy values into the caller buffer `str_buf`,
+ *                    the buffer is reused from the start on every parse
+ */
+#define WIMEY_STR_DUP 0
+#define WIMEY_STR_BORROW 1
+#define WIMEY_STR_BUFFER 2
+
 struct wimey_config_t {
 	int log_level;
 	char name[32];	/* program name */
@@ -65,6 +77,11 @@ struct wimey_config_t {
 	char *version;	/* version: x.x.x */
 	char *copyright; /* Example: Copyright (C) 2025 Davide Usberti  */
 	char *license; /* Example: Apache v2.0  */
+	int str_mode; /* WIMEY_STR_DUP, WIMEY_STR_BORROW or WIMEY_STR_BUFFER */
+	char *str_buf; /* WIMEY_STR_BUFFER destination */
+	size_t str_buf_len; /* size of str_buf in bytes */
+	int lazy; /* don't write value_dest, values are read with wimey_get_*() */
+	int response_files; /* expand `@file` tokens with the tokens in file */
 };
 
 struct wimey_command_t {
@@ -74,13 +91,31 @@ struct wimey_command_t {
 	char *value_name;	/* or NULL */
 	char *desc;
 	void (*callback)(const char *value);
+	char *parent; /* or NULL, path of the parent command: "remote" */
 };
 
 enum wimey_argument_type {
 	WIMEY_LONG = 1 << 0,
 	WIMEY_DOUBLE = 1 << 2,
 	WIMEY_STR = 1 << 3,
-	WIMEY_BOOL = 1 << 4
+	WIMEY_BOOL = 1 << 4,
+	WIMEY_LONG_LIST = 1 << 5, /* --ids 1,2,3 --ids 4 */
+	WIMEY_DOUBLE_LIST = 1 << 6,
+	WIMEY_STR_LIST = 1 << 7, /* --include a --include b */
+	WIMEY_CUSTOM = 1 << 8 /* converted by the argument parse_fn */
+};
+
+/* Destination (value_dest) of the list types. `items` is a
+ * long, double or char * array of `count` items, aligned to 64
+ * bytes. Numeric values are comma separated, every occurrence
+ * adds to the list and each source (argv, environment, config
+ * file) replaces what an earlier one set. The array is owned by
+ * the context: valid until the next parse or wimey_free_all(),
+ * strings follow str_mode. Lists are never lazy and a batch
+ * cell holds the raw value of the last occurrence. */
+struct wimey_list_t {
+	void *items;
+	size_t count;
 };
 
 struct wimey_argument_t {
@@ -92,6 +127,21 @@ struct wimey_argument_t {
 	char *value_name;
 	enum wimey_argument_type value_type; /* long, dobule, str, bool  */
 	char *desc;
+	char *env_key; /* or NULL, environment variable used when not in argv */
+	char *command; /* or NULL (global), path of the command it belongs to */
+	/* Constraints, checked once argv is consumed. Keys (long or
+	 * short) are separated by spaces, a config file or the
+	 * environment counts as given. A scoped argument is only
+	 * required when its command was used. */
+	int required; /* must be given */
+	char *requires; /* or NULL, keys that must be given with this one */
+	char *conflicts; /* or NULL, keys that can't be given with this one */
+	/* WIMEY_CUSTOM only: convert `val` into value_dest (durations,
+	 * sizes, addresses...), returns WIMEY_OK or WIMEY_ERR for an
+	 * invalid value. `val` points into argv or a config file, copy
+	 * what must outlive them. Custom values are never lazy and are
+	 * not serialized, a batch cell holds the raw value. */
+	int (*parse_fn)(const char *val, void *dest);
 	/* here no callback because arguments just 
 	 * assign a value to a variable */
 };
@@ -99,31 +149,197 @@ struct wimey_argument_t {
 struct __wimey_command_node {
 	struct wimey_command_t cmd;
 	struct __wimey_command_node *next;
+	uint32_t level; /* parent position + 1, 0 at top level */
+	uint32_t children; /* number of subcommands */
 };
 
 struct __wimey_argument_node {
 	struct wimey_argument_t argument;
 	struct __wimey_argument_node *next;
+	uint32_t level; /* command position + 1, 0 for global arguments */
+};
+
+/* Allocator hooks used for the registry storage and index,
+ * `user` is passed back to every call */
+struct wimey_allocator_t {
+	void *(*alloc)(size_t size, void *user);
+	void (*free)(void *ptr, void *user);
+	void *user;
+};
+
+/* Precomputed lookup index for static tables, generated by
+ * wimey_table_write_index(). Slots hold the table position + 1
+ * of each key (0 = empty), sizes are powers of two. */
+struct wimey_table_index_t {
+	const uint32_t *cmd_slots;
+	size_t cmd_size;
+	const uint32_t *arg_slots; /* both long and short keys */
+	size_t arg_size;
+};
+
+/* Typed value of an argument: `l` for WIMEY_LONG, `d` for
+ * WIMEY_DOUBLE, `s` for WIMEY_STR and `b` for flags */
+union wimey_value_t {
+	long l;
+	double d;
+	const char *s;
+	int b;
+};
+
+/* Struct-of-arrays output of wimey_parse_batch(): one column per
+ * registered argument (registry order) and one row per argv vector.
+ * The cell of argument `col` for vector `row` is at col * rows + row
+ * in both `values` and `seen`. Strings point into the parsed argv. */
+struct wimey_batch_t {
+	size_t rows;
+	size_t cols;
+	union wimey_value_t *values;
+	unsigned char *seen; /* 1 if the argument was given */
+	int *status; /* WIMEY_OK or WIMEY_ERR per row */
+};
+
+/* Parser counters, filled only when the library is built with
+ * -DWIMEY_STATS (all zero otherwise). Cycles are TSC ticks on
+ * x86 and nanoseconds elsewhere. */
+struct wimey_stats_t {
+	uint64_t parses;          /* parse calls */
+	uint64_t tokens;          /* argv tokens scanned, values included */
+	uint64_t key_compares;    /* key comparisons in registry lookups */
+	uint64_t conversions;     /* numeric value conversions */
+	uint64_t allocations;     /* allocations, strdup() included */
+	uint64_t lookup_cycles;   /* classifying tokens */
+	uint64_t command_cycles;  /* running command callbacks */
+	uint64_t argument_cycles; /* converting and storing values */
+};
+
+/* Why a parse (or a file load) failed, see wimey_get_error() */
+enum wimey_error_code {
+	WIMEY_E_NONE = 0,
+	WIMEY_E_NO_COMMAND,       /* commands registered but argv is empty */
+	WIMEY_E_UNKNOWN_KEY,      /* unknown flag in a bundle */
+	WIMEY_E_MISSING_VALUE,    /* key given without its required value */
+	WIMEY_E_UNEXPECTED_VALUE, /* "--flag=value" on a flag */
+	WIMEY_E_INVALID_VALUE,    /* value not convertible to the argument type */
+	WIMEY_E_FILE,             /* response or config file unreadable or malformed */
+	WIMEY_E_NO_MEMORY,
+	WIMEY_E_FORMAT,           /* serialized results or schema file malformed or foreign */
+	WIMEY_E_REQUIRED,         /* required argument not given */
+	WIMEY_E_REQUIRES,         /* argument given without one it requires (`value`) */
+	WIMEY_E_CONFLICT          /* argument given with one it conflicts with (`value`) */
 };
 
+/* First failure of the last wimey_parse() or wimey_load_config_file().
+ * `index` is the argv position of the offending token (the line for
+ * config files, -1 if none), `key` the matched key or NULL, `value`
+ * the offending value or NULL. Strings point into argv, the
+ * registry or the config file. A batch reports its first failing row. */
+struct wimey_error_t {
+	enum wimey_error_code code;
+	int index;
+	const char *key;
+	const char *value;
+};
+
+/* Log sink: receives every message the library would print, `level`
+ * is LOG_ERR_ONLY for errors, LOG_ERR_AND_WARNS for warnings and
+ * LOG_ALL for infos. Messages above the configured log_level are
+ * not formatted at all. */
+typedef void (*wimey_log_fn)(int level, const char *msg, void *user);
+
 /* ------ Public API ------ */
 
 /* Configuration & Init */
 int wimey_init(void);
+
+/* Same as wimey_init() but reserves room for `ncmds` commands and
+ * `nargs` arguments (count wimey_generate_help() as one argument),
+ * so the registry is allocated once and never moves. */
+int wimey_init_with_capacity(size_t ncmds, size_t nargs);
+
+/* Use custom allocation hooks, NULL restores malloc/free.
+ * Must be called before anything is registered. */
+int wimey_set_allocator(const struct wimey_allocator_t *allocator);
+
+/* Send the library messages to `fn` instead of stdout/stderr,
+ * NULL restores printing */
+void wimey_set_log_sink(wimey_log_fn fn, void *user);
+
+/* Failure of the last parse, code WIMEY_E_NONE if it succeeded */
+const struct wimey_error_t *wimey_get_error(void);
+const char *wimey_strerror(enum wimey_error_code code);
+
 int wimey_set_config(struct wimey_config_t *conf);
 struct wimey_config_t wimey_get_config(void);
 void wimey_free_all(void);
 
+/* Seal the registry: builds a hash index over command keys,
+ * long keys and short keys so that every argv token is resolved
+ * with a single lookup. Call it after the last wimey_add_command()
+ * / wimey_add_argument() / wimey_generate_help(), adding new
+ * entries fails until wimey_free_all(). The constraints of the
+ * arguments (required, requires, conflicts) are compiled here, or
+ * by the first parse of an unsealed registry.
+ * Returns WIMEY_OK, or WIMEY_ERR on allocation failure or when a
+ * constraint names an unknown key. */
+int wimey_finalize(void);
+
 /* This function is an universal wrapper 
- * both for commands and arguments  */
+ * both for commands and arguments.
+ * Arguments with an env_key get the value of that variable
+ * before argv is parsed, a sealed registry finds them all in
+ * one pass over environ. */
 int wimey_parse(int argc, char **argv);
 
-/* Commands */
+/* Static tables: parse argv directly against `const` arrays,
+ * no registration and no allocation at startup. Entries are
+ * used as is, an argument without a required value is a flag.
+ * `help` and `--help` work if the table contains a --help entry. */
+int wimey_parse_table(const struct wimey_argument_t *args, size_t n,
+		      const struct wimey_command_t *cmds, size_t m,
+		      int argc, char **argv);
+
+/* Same as wimey_parse_table() with a precomputed `index`, every
+ * token is then resolved with a single probe. */
+int wimey_parse_table_indexed(const struct wimey_argument_t *args, size_t n,
+			      const struct wimey_command_t *cmds, size_t m,
+			      const struct wimey_table_index_t *index,
+			      int argc, char **argv);
+
+/* Code generator for wimey_parse_table_indexed(): writes the C
+ * source of a `static const struct wimey_table_index_t name` for
+ * the given tables to `out`. Returns WIMEY_OK or WIMEY_ERR. */
+int wimey_table_write_index(FILE *out, const char *name,
+			    const struct wimey_argument_t *args, size_t n,
+			    const struct wimey_command_t *cmds, size_t m);
+
+/* Batch parsing: parse `n` argv vectors against the sealed registry
+ * (finalized if needed), results are written to `results` allocated
+ * by wimey_batch_init() instead of the value_dest pointers. Command
+ * callbacks are not called. Returns WIMEY_ERR if any row failed. */
+int wimey_parse_batch(size_t n, const int *argcs, char ***argvs,
+		      struct wimey_batch_t *results);
+
+/* Same as wimey_parse_batch() on `nthreads` threads (the caller
+ * included) sharing the sealed registry without locks, idle
+ * threads steal rows from the busy ones. Needs -pthread. */
+int wimey_parse_batch_parallel(size_t n, const int *argcs, char ***argvs,
+			       struct wimey_batch_t *results, size_t nthreads);
+
+/* Commands
+ * A command with `parent` set is a subcommand: "tool remote add"
+ * registers "remote", then "add" with parent "remote" (parents
+ * first, deeper paths are space separated: "remote add"). Once
+ * a command with subcommands is matched only its children and
+ * the arguments in its scope (plus the enclosing ones) are
+ * recognised. Arguments join a scope with `command`.
+ * Static tables ignore both fields. */
 int wimey_add_command(struct wimey_command_t cmd);
 
 /* In some case if we need to iterate on the commands list
  * this functions return his head, so It's an internal 
- * function but public. */
+ * function but public.
+ * Nodes live in a contiguous array: pointers are valid
+ * until the next wimey_add_command() or wimey_free_all(). */
 struct __wimey_command_node *wimey_get_commands_head(void);
 
 /* Arguments */
@@ -132,6 +348,205 @@ struct __wimey_argument_node *wimey_get_arguments_head(void);
 
 /* Utility function */
 int wimey_generate_help();
+
+/* Shell completion: `argv` holds the `argc` words after the program
+ * name, the last is the one being completed. Up to `max` matching
+ * keys go to `out`, returns the number of matches. The registry is
+ * finalized if needed. */
+size_t wimey_complete(int argc, char **argv, const char **out, size_t max);
+
+/* Write the completion hook for `shell` ("bash", "zsh" or "fish"),
+ * the hook runs `prog --wimey-complete <words>`. Returns WIMEY_OK
+ * or WIMEY_ERR. */
+int wimey_write_completion(FILE *out, const char *shell, const char *prog);
+
+/* Answer the hook: call it at the start of main(), before printing
+ * anything. If argv is a `--wimey-complete` request the completions
+ * are printed on stdout and it returns WIMEY_OK, the program should
+ * then exit. Returns WIMEY_ERR for any other argv, wimey_parse()
+ * never answers completion requests by itself. */
+int wimey_complete_main(int argc, char **argv);
+
+/* Configuration files: one "key=value" or "key value" per line,
+ * `key` is the long key without "--", '#' and ';' start comments.
+ * Keys after a "[remote add]" line are the arguments of that
+ * command (or of its parents), "[]" returns to the global ones.
+ * Fills value_dest of the registered arguments, load it before
+ * wimey_parse() so the command line wins. Returns WIMEY_OK or
+ * WIMEY_ERR on the first invalid entry (unknown keys only warn). */
+int wimey_load_config_file(const char *path);
+
+/* Files loaded with WIMEY_STR_DUP (and not lazy) are released by
+ * the next load. Otherwise borrowed strings and lazy values point
+ * into them and they stay mapped until this call, which also drops
+ * what they set for lazy reads and constraints, or wimey_free_all().
+ * Call it before reloading; borrowed strings dangle until set again. */
+void wimey_release_config_files(void);
+
+/* Lazy mode (config.lazy): parsing only records where each value
+ * is in argv, the accessors convert it on first use and keep the
+ * result. Config files loaded in lazy mode and the environment are
+ * recorded the same way (value_dest is left alone), argv wins.
+ * `key` is the long or the short key, argv must outlive the
+ * reads. Missing or invalid values read as 0 / NULL. */
+int wimey_is_set(const char *key);
+long wimey_get_long(const char *key);
+double wimey_get_double(const char *key);
+const char *wimey_get_str(const char *key);
+int wimey_get_bool(const char *key);
+
+/* Write the --help text in `buf` (at most `len` bytes, NUL
+ * terminated), returns the full length like snprintf() or 0 on
+ * error. After wimey_finalize() the text is rendered only once. */
+size_t wimey_render_help(char *buf, size_t len);
+
+/* Incremental re-parse, for long running programs reloading an
+ * argv-style line: compares argv with the line given to the
+ * previous call and converts and writes only the arguments whose
+ * value changed (the first call compares against nothing). Command
+ * callbacks are not run. Returns a bitmap of the changed arguments
+ * in registry order, test it with WIMEY_CHANGED(), or NULL on
+ * error. The bitmap is valid until the next call. */
+const uint64_t *wimey_reparse_delta(int argc, char **argv);
+
+#define WIMEY_CHANGED(bits, i) (((bits)[(i) / 64] >> ((i) % 64)) & 1)
+
+/* Binary parse results, to hand them to another process instead
+ * of argv: one fixed size record per registered argument (registry
+ * order) with long, double and flag values inline, strings and lists
+ * in a trailing blob. The header holds a version and a hash of the
+ * registered keys and types, a buffer made by a different registry
+ * is rejected. Native byte order.
+ * wimey_serialize_results() returns the size needed like snprintf()
+ * and writes only if it fits (0 on error). wimey_deserialize_results()
+ * validates the whole buffer before writing value_dest, strings point
+ * into `buf` (8 byte aligned, it must outlive them). */
+size_t wimey_serialize_results(void *buf, size_t len);
+int wimey_deserialize_results(const void *buf, size_t len);
+
+/* Schema snapshots, for programs registering many options at
+ * startup: wimey_save_schema() writes the sealed registry (keys,
+ * types, help strings, scopes and hash index) to `path`, finalizing
+ * it if needed. wimey_load_schema() replaces the registry with the
+ * one in the file, mapped and used in place without allocating
+ * nodes; it is sealed and kept until wimey_free_all(). The file is
+ * tied to the library version and the machine word size.
+ * value_dest, parse_fn and callbacks can't be saved: attach them
+ * with wimey_bind_argument() / wimey_bind_parser() (`key` long or
+ * short) and wimey_bind_command() (`path` like "remote add"), or
+ * read the values in lazy mode. All return WIMEY_OK or WIMEY_ERR. */
+int wimey_save_schema(const char *path);
+int wimey_load_schema(const char *path);
+int wimey_bind_argument(const char *key, void *dest);
+int wimey_bind_parser(const char *key, int (*parse_fn)(const char *val, void *dest));
+int wimey_bind_command(const char *path, void (*callback)(const char *value));
+
+/* Streaming parse, for REPLs and consoles fed as the user types:
+ * wimey_stream_feed() takes any slice of the input, partial tokens
+ * and the state of the line are kept between feeds and a command
+ * callback fires as soon as the command and its value are
+ * complete. A newline ends a line, which is parsed like one argv
+ * (tokens split like response files, no argv[0]); blank lines are
+ * ignored. Values borrowed from the input stay valid until the next
+ * line starts, those of the last line until the next
+ * wimey_stream_begin() or wimey_free_all(). The registry must not
+ * change until wimey_stream_end(), which ends the last line. feed
+ * and end return WIMEY_ERR if a line they ended failed, the rest of
+ * a failing line is skipped. */
+int wimey_stream_begin(void);
+int wimey_stream_feed(const char *bytes, size_t len);
+int wimey_stream_end(void);
+
+/* Counters accumulated since wimey_init() or the last reset */
+struct wimey_stats_t wimey_get_stats(void);
+void wimey_reset_stats(void);
+
+/* ------ Reentrant API ------ */
+
+/* Parser context: registry, configuration and parse state.
+ * The functions above work on a default context, the wimey_ctx_*
+ * variants take an explicit one so several argument vectors can be
+ * parsed at once, for example one context per worker thread.
+ * A context is not thread safe itself, contexts share nothing. */
+struct wimey_ctx;
+
+/* Allocate and release a context, NULL on allocation failure */
+struct wimey_ctx *wimey_ctx_new(void);
+void wimey_ctx_free(struct wimey_ctx *ctx);
+
+/* Context used by the non-ctx API */
+struct wimey_ctx *wimey_get_default_ctx(void);
+
+int wimey_ctx_init(struct wimey_ctx *ctx);
+int wimey_ctx_init_with_capacity(struct wimey_ctx *ctx, size_t ncmds, size_t nargs);
+int wimey_ctx_set_allocator(struct wimey_ctx *ctx,
+			    const struct wimey_allocator_t *allocator);
+void wimey_ctx_set_log_sink(struct wimey_ctx *ctx, wimey_log_fn fn, void *user);
+const struct wimey_error_t *wimey_ctx_get_error(struct wimey_ctx *ctx);
+int wimey_ctx_set_config(struct wimey_ctx *ctx, struct wimey_config_t *conf);
+struct wimey_config_t wimey_ctx_get_config(struct wimey_ctx *ctx);
+void wimey_ctx_free_all(struct wimey_ctx *ctx);
+int wimey_ctx_finalize(struct wimey_ctx *ctx);
+int wimey_ctx_parse(struct wimey_ctx *ctx, int argc, char **argv);
+int wimey_ctx_parse_table(struct wimey_ctx *ctx,
+			  const struct wimey_argument_t *args, size_t n,
+			  const struct wimey_command_t *cmds, size_t m,
+			  int argc, char **argv);
+int wimey_ctx_parse_table_indexed(struct wimey_ctx *ctx,
+				  const struct wimey_argument_t *args, size_t n,
+				  const struct wimey_command_t *cmds, size_t m,
+				  const struct wimey_table_index_t *index,
+				  int argc, char **argv);
+int wimey_ctx_add_command(struct wimey_ctx *ctx, struct wimey_command_t cmd);
+struct __wimey_command_node *wimey_ctx_get_commands_head(struct wimey_ctx *ctx);
+int wimey_ctx_add_argument(struct wimey_ctx *ctx, struct wimey_argument_t argument);
+struct __wimey_argument_node *wimey_ctx_get_arguments_head(struct wimey_ctx *ctx);
+int wimey_ctx_generate_help(struct wimey_ctx *ctx);
+size_t wimey_ctx_render_help(struct wimey_ctx *ctx, char *buf, size_t len);
+int wimey_ctx_load_config_file(struct wimey_ctx *ctx, const char *path);
+void wimey_ctx_release_config_files(struct wimey_ctx *ctx);
+size_t wimey_ctx_complete(struct wimey_ctx *ctx, int argc, char **argv,
+			  const char **out, size_t max);
+int wimey_ctx_complete_main(struct wimey_ctx *ctx, int argc, char **argv);
+int wimey_ctx_is_set(struct wimey_ctx *ctx, const char *key);
+long wimey_ctx_get_long(struct wimey_ctx *ctx, const char *key);
+double wimey_ctx_get_double(struct wimey_ctx *ctx, const char *key);
+const char *wimey_ctx_get_str(struct wimey_ctx *ctx, const char *key);
+int wimey_ctx_get_bool(struct wimey_ctx *ctx, const char *key);
+struct wimey_stats_t wimey_ctx_get_stats(struct wimey_ctx *ctx);
+void wimey_ctx_reset_stats(struct wimey_ctx *ctx);
+const uint64_t *wimey_ctx_reparse_delta(struct wimey_ctx *ctx, int argc, char **argv);
+size_t wimey_ctx_serialize_results(struct wimey_ctx *ctx, void *buf, size_t len);
+int wimey_ctx_deserialize_results(struct wimey_ctx *ctx, const void *buf, size_t len);
+int wimey_ctx_save_schema(struct wimey_ctx *ctx, const char *path);
+int wimey_ctx_load_schema(struct wimey_ctx *ctx, const char *path);
+int wimey_ctx_bind_argument(struct wimey_ctx *ctx, const char *key, void *dest);
+int wimey_ctx_bind_parser(struct wimey_ctx *ctx, const char *key,
+			  int (*parse_fn)(const char *val, void *dest));
+int wimey_ctx_bind_command(struct wimey_ctx *ctx, const char *path,
+			   void (*callback)(const char *value));
+int wimey_ctx_stream_begin(struct wimey_ctx *ctx);
+int wimey_ctx_stream_feed(struct wimey_ctx *ctx, const char *bytes, size_t len);
+int wimey_ctx_stream_end(struct wimey_ctx *ctx);
+int wimey_ctx_parse_batch(struct wimey_ctx *ctx, size_t n, const int *argcs,
+			  char ***argvs, struct wimey_batch_t *results);
+int wimey_ctx_parse_batch_parallel(struct wimey_ctx *ctx, size_t n, const int *argcs,
+				   char ***argvs, struct wimey_batch_t *results,
+				   size_t nthreads);
+
+/* Allocate (one block) and release the output of a batch of `rows`
+ * vectors for the arguments registered in `ctx` */
+int wimey_batch_init(struct wimey_ctx *ctx, struct wimey_batch_t *batch, size_t rows);
+void wimey_batch_free(struct wimey_ctx *ctx, struct wimey_batch_t *batch);
+
+/* Value converters: locale independent, the value goes to `out`
+ * and the return value is WIMEY_OK or WIMEY_ERR, unlike the
+ * wimey_val_to_* wrappers where an error reads as 0 */
+int wimey_val_parse_long(const char *val, long *out);
+int wimey_val_parse_u64(const char *val, uint64_t *out);
+int wimey_val_parse_double(const char *val, double *out);
+int wimey_val_parse_float(const char *val, float *out);
+
 long wimey_val_to_long(const char *val);
 int wimey_val_to_int(const char *val);
 float wimey_val_to_float(const char *val);